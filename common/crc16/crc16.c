@@ -0,0 +1,153 @@
+#include "crc16.h"
+#include "hardware/dma.h"
+
+// Table entries are the CRC of a byte shifted through eight polynomial steps.
+// Only bit 15 is tested, so the bits above 16 can be left until the end.
+#define CRC_BIT(c) (((c) << 1) ^ ((((c) >> 15) & 1) * CRC16_POLY))
+#define CRC_BYTE(i) ((uint16_t) CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT( \
+        CRC_BIT(CRC_BIT(CRC_BIT(CRC_BIT((uint32_t) (i) << 8)))))))))
+#define CRC_4(i) CRC_BYTE(i), CRC_BYTE((i) + 1), CRC_BYTE((i) + 2), CRC_BYTE((i) + 3)
+#define CRC_16(i) CRC_4(i), CRC_4((i) + 4), CRC_4((i) + 8), CRC_4((i) + 12)
+#define CRC_64(i) CRC_16(i), CRC_16((i) + 16), CRC_16((i) + 32), CRC_16((i) + 48)
+
+static const uint16_t crc_table[256] = {
+        CRC_64(0), CRC_64(64), CRC_64(128), CRC_64(192)
+};
+
+_Static_assert(sizeof(crc_table) / sizeof(crc_table[0]) == 256, "crc_table initializer expects 256 entries");
+
+// crc_slice[k][i] is the CRC of byte i followed by k + 1 zero bytes. The CRC
+// is linear, so every entry is the XOR of the entries for the bits set in i,
+// and those are kept as named constants: CRC_Bk_b is the CRC of bit b
+// followed by k zero bytes. Expanding the bit steps directly would double the
+// expression with every step. A zero byte shifts the CRC by one byte and
+// folds the byte shifted out back in through the level 0 constants.
+#define CRC_LIN(k, x) ((((x) & 1) * CRC_B##k##_0) ^ (((x) >> 1 & 1) * CRC_B##k##_1) ^ \
+        (((x) >> 2 & 1) * CRC_B##k##_2) ^ (((x) >> 3 & 1) * CRC_B##k##_3) ^ \
+        (((x) >> 4 & 1) * CRC_B##k##_4) ^ (((x) >> 5 & 1) * CRC_B##k##_5) ^ \
+        (((x) >> 6 & 1) * CRC_B##k##_6) ^ (((x) >> 7 & 1) * CRC_B##k##_7))
+#define CRC_ZERO(c) ((((c) << 8) & 0xFFFF) ^ CRC_LIN(0, (c) >> 8))
+#define CRC_LEVEL(k, j) CRC_B##k##_0 = CRC_ZERO(CRC_B##j##_0), CRC_B##k##_1 = CRC_ZERO(CRC_B##j##_1), \
+        CRC_B##k##_2 = CRC_ZERO(CRC_B##j##_2), CRC_B##k##_3 = CRC_ZERO(CRC_B##j##_3), \
+        CRC_B##k##_4 = CRC_ZERO(CRC_B##j##_4), CRC_B##k##_5 = CRC_ZERO(CRC_B##j##_5), \
+        CRC_B##k##_6 = CRC_ZERO(CRC_B##j##_6), CRC_B##k##_7 = CRC_ZERO(CRC_B##j##_7)
+
+enum {
+    CRC_B0_0 = CRC_BYTE(0x01), CRC_B0_1 = CRC_BYTE(0x02), CRC_B0_2 = CRC_BYTE(0x04), CRC_B0_3 = CRC_BYTE(0x08),
+    CRC_B0_4 = CRC_BYTE(0x10), CRC_B0_5 = CRC_BYTE(0x20), CRC_B0_6 = CRC_BYTE(0x40), CRC_B0_7 = CRC_BYTE(0x80),
+    CRC_LEVEL(1, 0),
+    CRC_LEVEL(2, 1),
+    CRC_LEVEL(3, 2)
+};
+
+#define SLICE_4(k, i) CRC_LIN(k, i), CRC_LIN(k, (i) + 1), CRC_LIN(k, (i) + 2), CRC_LIN(k, (i) + 3)
+#define SLICE_16(k, i) SLICE_4(k, i), SLICE_4(k, (i) + 4), SLICE_4(k, (i) + 8), SLICE_4(k, (i) + 12)
+#define SLICE_64(k, i) SLICE_16(k, i), SLICE_16(k, (i) + 16), SLICE_16(k, (i) + 32), SLICE_16(k, (i) + 48)
+#define SLICE_256(k) SLICE_64(k, 0), SLICE_64(k, 64), SLICE_64(k, 128), SLICE_64(k, 192)
+
+static const uint16_t crc_slice[3][256] = {
+        { SLICE_256(1) },
+        { SLICE_256(2) },
+        { SLICE_256(3) }
+};
+
+static Crc16Backend crc_backend = CRC16_TABLE;
+
+static int crc_dma_chan = -1;
+static bool crc_dma_ok;
+
+uint16_t crc16_reference(uint16_t crc, const uint8_t *data_p, size_t length)
+{
+    uint8_t x;
+    while(length--) {
+        x = crc >> 8 ^ *data_p++;
+        x ^= x >> 4;
+        crc = (crc << 8) ^ ((uint16_t) (x << 12)) ^ ((uint16_t) (x << 5)) ^ ((uint16_t) x);
+    }
+    return crc;
+}
+
+uint16_t crc16_table(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while(len--) {
+        crc = (crc << 8) ^ crc_table[(crc >> 8) ^ *data++];
+    }
+    return crc;
+}
+
+uint16_t crc16_slice4(uint16_t crc, const uint8_t *data, size_t len)
+{
+    while(len >= 4) {
+        crc = crc_slice[2][(crc >> 8) ^ data[0]] ^ crc_slice[1][(crc & 0xFF) ^ data[1]] ^
+              crc_slice[0][data[2]] ^ crc_table[data[3]];
+        data += 4;
+        len -= 4;
+    }
+    return crc16_table(crc, data, len);
+}
+
+static void crc16_sniff_start(uint dma_chan, uint16_t crc)
+{
+    dma_sniffer_enable(dma_chan, DMA_SNIFF_CTRL_CALC_VALUE_CRC16, true);
+    dma_sniffer_set_data_accumulator(crc);
+}
+
+static uint16_t crc16_sniff_result(void)
+{
+    return dma_sniffer_get_data_accumulator() & 0xFFFF;
+}
+
+static uint16_t crc16_dma_run(uint16_t crc, const uint8_t *data, size_t len)
+{
+    static uint8_t sink;
+
+    dma_channel_config config = dma_channel_get_default_config(crc_dma_chan);
+    channel_config_set_transfer_data_size(&config, DMA_SIZE_8);
+    channel_config_set_read_increment(&config, true);
+    channel_config_set_write_increment(&config, false);
+    channel_config_set_sniff_enable(&config, true);
+
+    crc16_sniff_start(crc_dma_chan, crc);
+    dma_channel_configure(crc_dma_chan, &config, &sink, data, len, true);
+    dma_channel_wait_for_finish_blocking(crc_dma_chan);
+    return crc16_sniff_result();
+}
+
+uint16_t crc16_dma(uint16_t crc, const uint8_t *data, size_t len)
+{
+    if(crc_dma_chan < 0) {
+        crc_dma_chan = dma_claim_unused_channel(false);
+        // Make sure the sniffer's CRC-16 agrees with ours before trusting it
+        static const uint8_t check[] = "123456789";
+        crc_dma_ok = crc_dma_chan >= 0 && crc16_dma_run(CRC16_INIT, check, 9) == 0x29B1;
+    }
+    if(!crc_dma_ok || len == 0) {
+        return crc16_slice4(crc, data, len);
+    }
+    return crc16_dma_run(crc, data, len);
+}
+
+void crc16_set_backend(Crc16Backend backend)
+{
+    crc_backend = backend;
+}
+
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len)
+{
+    switch(crc_backend) {
+        case CRC16_REFERENCE:
+            return crc16_reference(crc, data, len);
+        case CRC16_SLICE4:
+            return crc16_slice4(crc, data, len);
+        case CRC16_DMA:
+            return crc16_dma(crc, data, len);
+        case CRC16_TABLE:
+        default:
+            return crc16_table(crc, data, len);
+    }
+}
+
+uint16_t crc16(const uint8_t *data, size_t len)
+{
+    return crc16_update(CRC16_INIT, data, len);
+}
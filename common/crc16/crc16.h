@@ -0,0 +1,31 @@
+#ifndef CRC16_H
+#define CRC16_H
+
+#include "pico/stdlib.h"
+
+// CRC-16/CCITT-FALSE: polynomial 0x1021, initial value 0xFFFF, no reflection
+#define CRC16_POLY 0x1021
+#define CRC16_INIT 0xFFFF
+
+typedef enum Crc16Backend {
+    CRC16_REFERENCE, // bit-serial, no tables
+    CRC16_TABLE,     // one 256 entry lookup per byte
+    CRC16_SLICE4,    // four lookups per 4 bytes, 2 KiB of tables
+    CRC16_DMA        // DMA sniffer, falls back to CRC16_SLICE4 if unavailable
+} Crc16Backend;
+
+// Selects the back end used by crc16() and crc16_update(). CRC16_TABLE by default.
+void crc16_set_backend(Crc16Backend backend);
+
+uint16_t crc16(const uint8_t *data, size_t len);
+
+// Continues a CRC over more data, so a record and its stored CRC can be
+// checked in one pass: crc16_update(crc16(data, n), crc_bytes, 2) == 0.
+uint16_t crc16_update(uint16_t crc, const uint8_t *data, size_t len);
+
+uint16_t crc16_reference(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_table(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_slice4(uint16_t crc, const uint8_t *data, size_t len);
+uint16_t crc16_dma(uint16_t crc, const uint8_t *data, size_t len);
+
+#endif
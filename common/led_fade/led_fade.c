@@ -0,0 +1,141 @@
+#include "led_fade.h"
+#include "hardware/pwm.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+// x^2.2 approximated as 0.8x^2 + 0.2x^3, scaled to 16 bits
+#define GAMMA(l) ((uint16_t) (65535ULL * (l) * (l) * (4 * LED_FADE_LEVEL_MAX + (l)) \
+        / (5ULL * LED_FADE_LEVEL_MAX * LED_FADE_LEVEL_MAX * LED_FADE_LEVEL_MAX)))
+#define GAMMA_2(l) GAMMA(l), GAMMA((l) + 1)
+#define GAMMA_10(l) GAMMA_2(l), GAMMA_2((l) + 2), GAMMA_2((l) + 4), GAMMA_2((l) + 6), GAMMA_2((l) + 8)
+
+_Static_assert(LED_FADE_LEVEL_MAX == 100, "gamma_lut initializer expects 101 levels");
+
+static const uint16_t gamma_lut[LED_FADE_LEVEL_MAX + 1] = {
+        GAMMA_10(0), GAMMA_10(10), GAMMA_10(20), GAMMA_10(30), GAMMA_10(40),
+        GAMMA_10(50), GAMMA_10(60), GAMMA_10(70), GAMMA_10(80), GAMMA_10(90),
+        GAMMA(100)
+};
+
+typedef struct FadeSlice {
+    LedGroupSlice *group_slice;
+    uint32_t counts;
+    uint dma_chan;
+    uint32_t buf[LED_FADE_MAX_STEPS];
+} FadeSlice;
+
+static LedGroup *fade_group;
+static FadeSlice fade_slices[LED_GROUP_MAX_SLICES];
+static uint fade_slice_count;
+static uint32_t fade_wrap_hz;
+
+static uint8_t fade_from;
+static uint8_t fade_target;
+static uint32_t fade_steps;
+
+uint16_t led_fade_gamma(uint8_t level)
+{
+    if(level > LED_FADE_LEVEL_MAX) {
+        level = LED_FADE_LEVEL_MAX;
+    }
+    return gamma_lut[level];
+}
+
+static uint16_t fade_cc(FadeSlice *fs, uint8_t level)
+{
+    return ((uint32_t) led_fade_gamma(level) * fs->counts + 0x8000) >> 16;
+}
+
+void led_fade_init(LedGroup *group)
+{
+    fade_group = group;
+    fade_slice_count = group->slice_count;
+
+    for(uint i = 0; i < fade_slice_count; i++) {
+        FadeSlice *fs = &fade_slices[i];
+        uint slice = group->slices[i].slice;
+
+        fs->group_slice = &group->slices[i];
+        fs->counts = pwm_hw->slice[slice].top + 1;
+        fs->dma_chan = dma_claim_unused_channel(true);
+
+        dma_channel_config c = dma_channel_get_default_config(fs->dma_chan);
+        channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+        channel_config_set_read_increment(&c, true);
+        channel_config_set_write_increment(&c, false);
+        channel_config_set_dreq(&c, pwm_get_dreq(slice));
+        dma_channel_configure(fs->dma_chan, &c, &pwm_hw->slice[slice].cc, fs->buf, 0, false);
+    }
+
+    if(fade_slice_count > 0) {
+        // DIV is 8.4 fixed point
+        uint32_t div = pwm_hw->slice[group->slices[0].slice].div;
+        fade_wrap_hz = (uint32_t) ((uint64_t) clock_get_hz(clk_sys) * 16 / (div * fade_slices[0].counts));
+    }
+
+    fade_from = 0;
+    fade_target = 0;
+    fade_steps = 0;
+}
+
+bool led_fade_is_busy(void)
+{
+    return fade_slice_count > 0 && dma_channel_is_busy(fade_slices[0].dma_chan);
+}
+
+uint8_t led_fade_get_level(void)
+{
+    if(!led_fade_is_busy()) {
+        return fade_target;
+    }
+    uint32_t done = fade_steps - dma_channel_hw_addr(fade_slices[0].dma_chan)->transfer_count;
+    return fade_from + ((int32_t) fade_target - fade_from) * (int32_t) done / (int32_t) fade_steps;
+}
+
+void led_fade_to(uint8_t level, uint32_t duration_ms)
+{
+    if(level > LED_FADE_LEVEL_MAX) {
+        level = LED_FADE_LEVEL_MAX;
+    }
+
+    uint8_t from = led_fade_get_level();
+    uint32_t mask = 0;
+
+    for(uint i = 0; i < fade_slice_count; i++) {
+        dma_channel_abort(fade_slices[i].dma_chan);
+    }
+
+    fade_from = from;
+    fade_target = level;
+
+    // Nothing to stream for a jump; all slices run the same period, so one
+    // level fits them all
+    uint32_t steps = duration_ms * fade_wrap_hz / 1000;
+    if(steps <= 1) {
+        fade_steps = 0;
+        if(fade_slice_count > 0) {
+            led_group_set_all(fade_group, fade_cc(&fade_slices[0], level));
+        }
+        return;
+    } else if(steps > LED_FADE_MAX_STEPS) {
+        steps = LED_FADE_MAX_STEPS;
+    }
+
+    for(uint i = 0; i < fade_slice_count; i++) {
+        FadeSlice *fs = &fade_slices[i];
+
+        for(uint32_t s = 0; s < steps; s++) {
+            uint8_t l = from + ((int32_t) level - from) * (int32_t) (s + 1) / (int32_t) steps;
+            fs->buf[s] = led_group_slice_word(fs->group_slice, fade_cc(fs, l));
+        }
+        fs->group_slice->cc = fs->buf[steps - 1];
+
+        dma_channel_set_read_addr(fs->dma_chan, fs->buf, false);
+        dma_channel_set_trans_count(fs->dma_chan, steps, false);
+        mask |= 1u << fs->dma_chan;
+    }
+
+    fade_steps = steps;
+
+    dma_start_channel_mask(mask);
+}
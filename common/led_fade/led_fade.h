@@ -0,0 +1,22 @@
+#ifndef LED_FADE_H
+#define LED_FADE_H
+
+#include "pico/stdlib.h"
+#include "led_group.h"
+
+#define LED_FADE_LEVEL_MAX 100
+#define LED_FADE_MAX_STEPS 256 // one CC value per PWM period, 256 ms at 1 kHz
+
+// The group must already be initialized and running.
+void led_fade_init(LedGroup *group);
+
+// Fades all pins to a perceptual level (0..LED_FADE_LEVEL_MAX). The CC values are
+// streamed by DMA on the PWM wrap, so the call returns immediately.
+// Durations under two PWM periods set the level at once.
+void led_fade_to(uint8_t level, uint32_t duration_ms);
+
+bool led_fade_is_busy(void);
+uint8_t led_fade_get_level(void);
+uint16_t led_fade_gamma(uint8_t level);
+
+#endif
@@ -0,0 +1,62 @@
+#include "led_group.h"
+
+bool led_group_init(LedGroup *group, const uint *gpios, uint count, pwm_config *config)
+{
+    if(count > LED_GROUP_MAX_LEDS) {
+        return false;
+    }
+
+    group->count = count;
+    group->slice_count = 0;
+
+    for(uint i = 0; i < count; i++) {
+        uint slice = pwm_gpio_to_slice_num(gpios[i]);
+        uint shift = pwm_gpio_to_channel(gpios[i]) == PWM_CHAN_A ? PWM_CH0_CC_A_LSB : PWM_CH0_CC_B_LSB;
+
+        uint j = 0;
+        while(j < group->slice_count && group->slices[j].slice != slice) {
+            j++;
+        }
+        if(j == group->slice_count) {
+            if(group->slice_count == LED_GROUP_MAX_SLICES) {
+                return false;
+            }
+            group->slices[j].slice = slice;
+            group->slices[j].mask = 0;
+            group->slices[j].cc = 0;
+            group->slice_count++;
+        }
+
+        group->slices[j].mask |= 0xFFFFu << shift;
+    }
+
+    uint32_t enable_mask = 0;
+
+    for(uint j = 0; j < group->slice_count; j++) {
+        pwm_set_enabled(group->slices[j].slice, false);
+        pwm_init(group->slices[j].slice, config, false);
+        enable_mask |= 1u << group->slices[j].slice;
+    }
+
+    for(uint i = 0; i < count; i++) {
+        gpio_set_function(gpios[i], GPIO_FUNC_PWM);
+    }
+
+    pwm_set_mask_enabled(pwm_hw->en | enable_mask);
+    return true;
+}
+
+uint32_t led_group_slice_word(const LedGroupSlice *gs, uint16_t level)
+{
+    uint32_t word = ((uint32_t) level << PWM_CH0_CC_B_LSB) | level;
+    return (word & gs->mask) | (gs->cc & ~gs->mask);
+}
+
+void led_group_set_all(LedGroup *group, uint16_t level)
+{
+    for(uint j = 0; j < group->slice_count; j++) {
+        LedGroupSlice *gs = &group->slices[j];
+        gs->cc = led_group_slice_word(gs, level);
+        pwm_set_both_levels(gs->slice, gs->cc & 0xFFFFu, gs->cc >> PWM_CH0_CC_B_LSB);
+    }
+}
@@ -0,0 +1,35 @@
+#ifndef LED_GROUP_H
+#define LED_GROUP_H
+
+#include "pico/stdlib.h"
+#include "hardware/pwm.h"
+
+#define LED_GROUP_MAX_LEDS 8
+#define LED_GROUP_MAX_SLICES 4
+
+typedef struct LedGroupSlice {
+    uint slice;
+    uint32_t mask;  // CC bits owned by the group
+    uint32_t cc;    // last value written to the CC register
+} LedGroupSlice;
+
+typedef struct LedGroup {
+    uint count;
+    uint slice_count;
+    LedGroupSlice slices[LED_GROUP_MAX_SLICES];
+} LedGroup;
+
+// Resolves the slice/channel layout once, configures every slice with the same
+// config and starts them together so all channels share the same PWM period.
+bool led_group_init(LedGroup *group, const uint *gpios, uint count, pwm_config *config);
+
+// Sets every pin of the group to `level` counts with one CC write per slice.
+// CC is double-buffered, so the new level takes effect together at the next
+// wrap.
+void led_group_set_all(LedGroup *group, uint16_t level);
+
+// The CC word that puts the group's channels of `gs` at `level` and leaves
+// the rest of the slice as last written
+uint32_t led_group_slice_word(const LedGroupSlice *gs, uint16_t level);
+
+#endif
@@ -0,0 +1,36 @@
+#include "debounce.h"
+
+static void button_emit(ButtonEmit emit, const Button *button, ButtonEventType type)
+{
+    ButtonEvent event = { button->pin, type };
+    emit(&event);
+}
+
+void debounce_update(Button *buttons, uint8_t count, uint32_t levels, ButtonEmit emit)
+{
+    for(uint8_t i = 0; i < count; i++) {
+        Button *button = &buttons[i];
+        bool down = !(levels & (1u << button->pin));
+
+        if(down && button->integrator < DEBOUNCE_SAMPLES) {
+            button->integrator++;
+        } else if(!down && button->integrator > 0) {
+            button->integrator--;
+        }
+
+        if(!button->pressed && button->integrator == DEBOUNCE_SAMPLES) {
+            button->pressed = true;
+            button->held_ms = 0;
+            button_emit(emit, button, BUTTON_PRESSED);
+        } else if(button->pressed && button->integrator == 0) {
+            button->pressed = false;
+            button_emit(emit, button, BUTTON_RELEASED);
+        } else if(button->pressed && button->repeat) {
+            button->held_ms += DEBOUNCE_SAMPLE_MS;
+            if(button->held_ms >= REPEAT_DELAY_MS) {
+                button->held_ms = REPEAT_DELAY_MS - REPEAT_INTERVAL_MS;
+                button_emit(emit, button, BUTTON_REPEAT);
+            }
+        }
+    }
+}
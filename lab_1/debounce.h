@@ -0,0 +1,36 @@
+#ifndef DEBOUNCE_H
+#define DEBOUNCE_H
+
+#include "pico/stdlib.h"
+
+#define DEBOUNCE_SAMPLE_MS 1
+#define DEBOUNCE_SAMPLES 20 // consecutive samples at the new level before an edge is accepted
+#define REPEAT_DELAY_MS 100
+#define REPEAT_INTERVAL_MS 100
+
+typedef enum ButtonEventType {
+    BUTTON_PRESSED,
+    BUTTON_RELEASED,
+    BUTTON_REPEAT
+} ButtonEventType;
+
+typedef struct ButtonEvent {
+    uint8_t pin;
+    ButtonEventType type;
+} ButtonEvent;
+
+typedef struct Button {
+    uint8_t pin;
+    bool repeat;
+    bool pressed;
+    uint8_t integrator;
+    uint16_t held_ms;
+} Button;
+
+typedef void (*ButtonEmit)(const ButtonEvent *event);
+
+// Feeds one sample to every button. `levels` holds the pin levels the way
+// gpio_get_all() returns them; the buttons are active low.
+void debounce_update(Button *buttons, uint8_t count, uint32_t levels, ButtonEmit emit);
+
+#endif
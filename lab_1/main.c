@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
+#include "pico/util/queue.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
+#include "led_group.h"
+#include "led_fade.h"
+#include "debounce.h"
 
 #define BUTTON_TOGGLE 8
 #define BUTTON_BRIGHTNESS_INC 9
@@ -12,8 +16,23 @@
 #define LED_2 22
 
 #define PWM_TOP (1000)
-#define CC_STEP 50
-#define DEBOUNCE_DELAY_MS 100
+#define BRIGHTNESS_STEP 5
+#define FADE_STEP_MS 100
+#define FADE_TOGGLE_MS 250
+
+#define BUTTON_COUNT 3
+#define BUTTON_EVENT_QUEUE_LEN 16
+
+static Button buttons[BUTTON_COUNT] = {
+        {BUTTON_TOGGLE, false},
+        {BUTTON_BRIGHTNESS_INC, true},
+        {BUTTON_BRIGHTNESS_DEC, true},
+};
+
+static LedGroup leds;
+
+static queue_t button_events;
+static repeating_timer_t debounce_timer;
 
 void init_gpio()
 {
@@ -32,44 +51,35 @@ void init_gpio()
 
 void init_pwm()
 {
-    uint slice_num_1 = pwm_gpio_to_slice_num(LED_0);
-    uint slice_num_2 = pwm_gpio_to_slice_num(LED_1);
-    uint slice_num_3 = pwm_gpio_to_slice_num(LED_2);
-
-    pwm_set_enabled(slice_num_1, false);
-    pwm_set_enabled(slice_num_2, false);
-    pwm_set_enabled(slice_num_3, false);
+    const uint pins[] = { LED_0, LED_1, LED_2 };
 
     pwm_config config = pwm_get_default_config();
     pwm_config_set_clkdiv_int(&config, 125);
     pwm_config_set_wrap(&config, PWM_TOP - 1);
 
-    pwm_init(slice_num_1, &config, false);
-    pwm_init(slice_num_2, &config, false);
-    pwm_init(slice_num_3, &config, false);
-
-    gpio_set_function(LED_0, GPIO_FUNC_PWM);
-    gpio_set_function(LED_1, GPIO_FUNC_PWM);
-    gpio_set_function(LED_2, GPIO_FUNC_PWM);
+    led_group_init(&leds, pins, count_of(pins), &config);
+}
 
-    pwm_set_enabled(slice_num_1, true);
-    pwm_set_enabled(slice_num_2, true);
-    pwm_set_enabled(slice_num_3, true);
+static void button_emit(const ButtonEvent *event)
+{
+    queue_try_add(&button_events, event);
 }
 
-void led_brightness_change(uint16_t cc)
+bool debounce_sample(repeating_timer_t *rt)
 {
-    uint slice_num_1 = pwm_gpio_to_slice_num(LED_0);
-    uint slice_num_2 = pwm_gpio_to_slice_num(LED_1);
-    uint slice_num_3 = pwm_gpio_to_slice_num(LED_2);
+    debounce_update(buttons, BUTTON_COUNT, gpio_get_all(), button_emit);
+    return true;
+}
 
-    uint channel_num_1 = pwm_gpio_to_channel(LED_0);
-    uint channel_num_2 = pwm_gpio_to_channel(LED_1);
-    uint channel_num_3 = pwm_gpio_to_channel(LED_2);
+void init_buttons(void)
+{
+    queue_init(&button_events, sizeof(ButtonEvent), BUTTON_EVENT_QUEUE_LEN);
+    add_repeating_timer_ms(DEBOUNCE_SAMPLE_MS, debounce_sample, NULL, &debounce_timer);
+}
 
-    pwm_set_chan_level(slice_num_1, channel_num_1, cc);
-    pwm_set_chan_level(slice_num_2, channel_num_2, cc);
-    pwm_set_chan_level(slice_num_3, channel_num_3, cc);
+void led_brightness_change(uint8_t brightness, uint32_t duration_ms)
+{
+    led_fade_to(brightness, duration_ms);
 }
 
 int main(void)
@@ -80,73 +90,52 @@ int main(void)
 
     init_gpio();
     init_pwm();
+    led_fade_init(&leds);
 
-    uint16_t cc = PWM_TOP / 2;
+    init_buttons();
 
-    bool leds_on = false;
+    uint8_t brightness = LED_FADE_LEVEL_MAX / 2;
 
-    bool last_toggle_button_state = gpio_get(BUTTON_TOGGLE);
-    bool last_inc_button_state = gpio_get(BUTTON_BRIGHTNESS_INC);
-    bool last_dec_button_state = gpio_get(BUTTON_BRIGHTNESS_DEC);
+    bool leds_on = false;
 
     while(true) {
-        bool toggle_button_state = !gpio_get(BUTTON_TOGGLE);
-        bool inc_button_state = !gpio_get(BUTTON_BRIGHTNESS_INC);
-        bool dec_button_state = !gpio_get(BUTTON_BRIGHTNESS_DEC);
+        ButtonEvent event;
 
-        if(toggle_button_state != last_toggle_button_state) {
-            busy_wait_ms(DEBOUNCE_DELAY_MS);
-            last_toggle_button_state = toggle_button_state;
+        while(queue_try_remove(&button_events, &event)) {
+            if(event.type == BUTTON_RELEASED) {
+                continue;
+            }
 
-            if(toggle_button_state) {
+            if(event.pin == BUTTON_TOGGLE) {
                 if(!leds_on) {
-                    led_brightness_change(cc);
+                    led_brightness_change(brightness, FADE_TOGGLE_MS);
                     leds_on = true;
                 } else {
-                    if(cc == 0) {
-                        cc = PWM_TOP / 2;
-                        led_brightness_change(cc);
+                    if(brightness == 0) {
+                        brightness = LED_FADE_LEVEL_MAX / 2;
+                        led_brightness_change(brightness, FADE_TOGGLE_MS);
                     } else {
-                        led_brightness_change(0);
+                        led_brightness_change(0, FADE_TOGGLE_MS);
                         leds_on = false;
                     }
                 }
-            }
-        }
-
-        if(inc_button_state != last_inc_button_state && leds_on) {
-            busy_wait_ms(DEBOUNCE_DELAY_MS);
-            last_inc_button_state = inc_button_state;
-
-            if(inc_button_state) {
-                while(!gpio_get(BUTTON_BRIGHTNESS_INC)) {
-                    cc += CC_STEP;
-                    if(cc > PWM_TOP) {
-                        cc = PWM_TOP;
-                        break;
-                    }
-                    led_brightness_change(cc);
-                    busy_wait_ms(DEBOUNCE_DELAY_MS);
+            } else if(event.pin == BUTTON_BRIGHTNESS_INC && leds_on) {
+                brightness += BRIGHTNESS_STEP;
+                if(brightness > LED_FADE_LEVEL_MAX) {
+                    brightness = LED_FADE_LEVEL_MAX;
                 }
-            }
-        }
-
-        if(dec_button_state != last_dec_button_state && leds_on) {
-            busy_wait_ms(DEBOUNCE_DELAY_MS);
-            last_dec_button_state = dec_button_state;
-
-            if(dec_button_state) {
-                while(!gpio_get(BUTTON_BRIGHTNESS_DEC)) {
-                    if(cc < CC_STEP) {
-                        cc = 0;
-                    } else {
-                        cc -= CC_STEP;
-                    }
-                    led_brightness_change(cc);
-                    busy_wait_ms(DEBOUNCE_DELAY_MS);
+                led_brightness_change(brightness, FADE_STEP_MS);
+            } else if(event.pin == BUTTON_BRIGHTNESS_DEC && leds_on) {
+                if(brightness < BRIGHTNESS_STEP) {
+                    brightness = 0;
+                } else {
+                    brightness -= BRIGHTNESS_STEP;
                 }
+                led_brightness_change(brightness, FADE_STEP_MS);
             }
         }
+
+        tight_loop_contents();
     }
 
     return 0;
@@ -0,0 +1,85 @@
+#include "encoder.h"
+
+// Gain for a detent that came i buckets after the previous one, falling off
+// quadratically from ACCEL_MAX_GAIN to 1.
+#define ACCEL_GAIN(i) (1 + (ACCEL_MAX_GAIN - 1) * (ACCEL_BUCKETS - 1 - (i)) * (ACCEL_BUCKETS - 1 - (i)) \
+        / ((ACCEL_BUCKETS - 1) * (ACCEL_BUCKETS - 1)))
+#define ACCEL_GAIN_4(i) ACCEL_GAIN(i), ACCEL_GAIN((i) + 1), ACCEL_GAIN((i) + 2), ACCEL_GAIN((i) + 3)
+
+// Indexed by (previous AB << 2) | current AB. ENCODER_INVALID marks a jump where
+// both channels changed, which only bounce or a missed edge can produce.
+static const int8_t quadrature_table[16] = {
+        0, -1, 1, ENCODER_INVALID,
+        1, 0, ENCODER_INVALID, -1,
+        -1, ENCODER_INVALID, 0, 1,
+        ENCODER_INVALID, 1, -1, 0
+};
+
+_Static_assert(ACCEL_BUCKETS == 32, "accel_table initializer expects 32 buckets");
+
+static const uint8_t accel_table[ACCEL_BUCKETS] = {
+        ACCEL_GAIN_4(0), ACCEL_GAIN_4(4), ACCEL_GAIN_4(8), ACCEL_GAIN_4(12),
+        ACCEL_GAIN_4(16), ACCEL_GAIN_4(20), ACCEL_GAIN_4(24), ACCEL_GAIN_4(28)
+};
+
+// Accelerated steps, written only by encoder_decode. The main loop keeps its own copy
+// and applies the difference, so detents are never dropped and no lock is needed.
+static volatile int32_t encoder_position = 0;
+static volatile uint32_t encoder_errors = 0;
+static uint8_t encoder_state;
+static int8_t encoder_quarters;
+static int8_t encoder_last_dir;
+static uint32_t encoder_last_detent_us;
+static int32_t encoder_taken;
+
+void encoder_decode(uint8_t ab, uint32_t now_us)
+{
+    int8_t delta = quadrature_table[(encoder_state << 2) | ab];
+    encoder_state = ab;
+
+    if(delta == ENCODER_INVALID) {
+        encoder_errors = encoder_errors + 1;
+        return;
+    }
+
+    encoder_quarters += delta;
+    if(encoder_quarters != ENCODER_QUARTERS_PER_STEP && encoder_quarters != -ENCODER_QUARTERS_PER_STEP) {
+        return;
+    }
+
+    int8_t dir = encoder_quarters > 0 ? 1 : -1;
+    encoder_quarters = 0;
+
+    uint32_t bucket = (now_us - encoder_last_detent_us) >> ACCEL_BUCKET_SHIFT;
+    encoder_last_detent_us = now_us;
+
+    // A reversal is always a fine adjustment
+    uint8_t gain = 1;
+    if(dir == encoder_last_dir && bucket < ACCEL_BUCKETS) {
+        gain = accel_table[bucket];
+    }
+    encoder_last_dir = dir;
+
+    encoder_position = encoder_position + dir * gain;
+}
+
+void encoder_reset(uint8_t ab)
+{
+    encoder_state = ab;
+    encoder_quarters = 0;
+    encoder_last_dir = 0;
+    encoder_taken = encoder_position;
+}
+
+int32_t encoder_take_steps(void)
+{
+    int32_t position = encoder_position;
+    int32_t steps = (int32_t) ((uint32_t) position - (uint32_t) encoder_taken);
+    encoder_taken = position;
+    return steps;
+}
+
+uint32_t encoder_get_errors(void)
+{
+    return encoder_errors;
+}
@@ -0,0 +1,26 @@
+#ifndef ENCODER_H
+#define ENCODER_H
+
+#include "pico/stdlib.h"
+
+#define ENCODER_QUARTERS_PER_STEP 2
+#define ENCODER_INVALID 2
+
+#define ACCEL_BUCKETS 32
+#define ACCEL_BUCKET_SHIFT 11 // 2.048 ms per bucket, detents slower than ~64 ms get gain 1
+#define ACCEL_MAX_GAIN 8
+
+// Feeds one AB sample (A in bit 1) taken at `now_us`. Called from the GPIO IRQ
+// on every edge, or for every state the PIO sampler pushed.
+void encoder_decode(uint8_t ab, uint32_t now_us);
+
+// Starts decoding from the current pin state
+void encoder_reset(uint8_t ab);
+
+// Accelerated steps since the last call. Only the main loop calls this.
+int32_t encoder_take_steps(void);
+
+// Transitions where both channels changed at once
+uint32_t encoder_get_errors(void);
+
+#endif
@@ -1,9 +1,13 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
-#include "pico/util/queue.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
 #include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "quadrature.pio.h"
+#include "led_group.h"
+#include "led_fade.h"
+#include "encoder.h"
 
 #define LED_0 20
 #define LED_1 21
@@ -14,16 +18,20 @@
 #define ROT_SW 12
 
 #define PWM_TOP (1000)
-#define CC_STEP 25
+#define BRIGHTNESS_STEP 2
+#define FADE_STEP_MS 30
+#define FADE_TOGGLE_MS 250
 #define DEBOUNCE_DELAY_MS 100
 
-static queue_t events_clockwise;
-static queue_t events_counterclockwise;
+#define ENCODER_USE_PIO 0
+#define ENCODER_PIO pio0
+#define ENCODER_PIO_CLKDIV 250.0f // 100 kHz sampling, filters short glitches
 
-volatile bool clockwise = false;
-volatile bool counterclockwise = false;
+static LedGroup leds;
 
-bool leds_on = false;
+#if ENCODER_USE_PIO
+static uint encoder_sm;
+#endif
 
 void init_gpio(void)
 {
@@ -40,83 +48,71 @@ void init_gpio(void)
 
 void init_pwm(void)
 {
-    uint slice_num_1 = pwm_gpio_to_slice_num(LED_0);
-    uint slice_num_2 = pwm_gpio_to_slice_num(LED_1);
-    uint slice_num_3 = pwm_gpio_to_slice_num(LED_2);
-
-    pwm_set_enabled(slice_num_1, false);
-    pwm_set_enabled(slice_num_2, false);
-    pwm_set_enabled(slice_num_3, false);
+    const uint pins[] = { LED_0, LED_1, LED_2 };
 
     pwm_config config = pwm_get_default_config();
     pwm_config_set_clkdiv_int(&config, 125);
     pwm_config_set_wrap(&config, PWM_TOP - 1);
 
-    pwm_init(slice_num_1, &config, false);
-    pwm_init(slice_num_2, &config, false);
-    pwm_init(slice_num_3, &config, false);
-
-    gpio_set_function(LED_0, GPIO_FUNC_PWM);
-    gpio_set_function(LED_1, GPIO_FUNC_PWM);
-    gpio_set_function(LED_2, GPIO_FUNC_PWM);
-
-    pwm_set_enabled(slice_num_1, true);
-    pwm_set_enabled(slice_num_2, true);
-    pwm_set_enabled(slice_num_3, true);
+    led_group_init(&leds, pins, count_of(pins), &config);
 }
 
-void led_brightness_control(uint16_t cc)
+void led_brightness_control(uint8_t brightness, uint32_t duration_ms)
 {
-    uint slice_num_1 = pwm_gpio_to_slice_num(LED_0);
-    uint slice_num_2 = pwm_gpio_to_slice_num(LED_1);
-    uint slice_num_3 = pwm_gpio_to_slice_num(LED_2);
-
-    uint channel_num_1 = pwm_gpio_to_channel(LED_0);
-    uint channel_num_2 = pwm_gpio_to_channel(LED_1);
-    uint channel_num_3 = pwm_gpio_to_channel(LED_2);
-
-    pwm_set_chan_level(slice_num_1, channel_num_1, cc);
-    pwm_set_chan_level(slice_num_2, channel_num_2, cc);
-    pwm_set_chan_level(slice_num_3, channel_num_3, cc);
+    led_fade_to(brightness, duration_ms);
 }
 
-void toggle_leds(bool *leds_on, uint16_t *cc) {
+void toggle_leds(bool *leds_on, uint8_t *brightness) {
     if(!(*leds_on)) {
-        led_brightness_control(*cc);
+        led_brightness_control(*brightness, FADE_TOGGLE_MS);
         *leds_on = true;
     } else {
-        if(*cc == 0) {
-            *cc = 500;
-            led_brightness_control(*cc);
+        if(*brightness == 0) {
+            *brightness = LED_FADE_LEVEL_MAX / 2;
+            led_brightness_control(*brightness, FADE_TOGGLE_MS);
         } else {
-            led_brightness_control(0);
+            led_brightness_control(0, FADE_TOGGLE_MS);
             *leds_on = false;
         }
     }
 }
 
-void gpio_handler(void)
+static inline uint8_t encoder_read_ab(void)
 {
-    static bool prev_state_a = false;
-    static bool prev_state_b = false;
-
-    bool state_a = gpio_get(ROT_B);
-    bool state_b = gpio_get(ROT_A);
-
-    if(leds_on) {
-        if(state_a != prev_state_a) {
-            if(state_a == state_b) {
-                clockwise = true;
-                queue_try_add(&events_clockwise, &clockwise);
-            } else {
-                queue_try_add(&events_counterclockwise, &counterclockwise);
-                counterclockwise = true;
-            }
-        }
-    }
+    uint32_t levels = gpio_get_all();
+    return (((levels >> ROT_A) & 1) << 1) | ((levels >> ROT_B) & 1);
+}
 
-    prev_state_a = state_a;
-    prev_state_b = state_b;
+void gpio_handler(uint gpio, uint32_t events)
+{
+    encoder_decode(encoder_read_ab(), time_us_32());
+}
+
+void init_encoder(void)
+{
+    encoder_reset(encoder_read_ab());
+
+#if ENCODER_USE_PIO
+    // ROT_B is ROT_A + 1, so both pins fit one 2-bit IN
+    encoder_sm = pio_claim_unused_sm(ENCODER_PIO, true);
+    uint offset = pio_add_program(ENCODER_PIO, &quadrature_program);
+    quadrature_program_init(ENCODER_PIO, encoder_sm, offset, ROT_A, ENCODER_PIO_CLKDIV);
+#else
+    gpio_set_irq_enabled_with_callback(ROT_A, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &gpio_handler);
+    gpio_set_irq_enabled_with_callback(ROT_B, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &gpio_handler);
+#endif
+}
+
+// Hands the states the sampler pushed to the decoder. The timestamps are
+// only as fine as this loop, which is plenty for the acceleration buckets.
+void encoder_poll(void)
+{
+#if ENCODER_USE_PIO
+    while(!pio_sm_is_rx_fifo_empty(ENCODER_PIO, encoder_sm)) {
+        uint32_t ba = pio_sm_get(ENCODER_PIO, encoder_sm);
+        encoder_decode(((ba & 1) << 1) | (ba >> 1), time_us_32());
+    }
+#endif
 }
 
 int main(void)
@@ -127,14 +123,12 @@ int main(void)
 
     init_gpio();
     init_pwm();
+    led_fade_init(&leds);
 
-    queue_init(&events_clockwise, sizeof(bool), 10);
-    queue_init(&events_counterclockwise, sizeof(bool), 10);
+    uint8_t brightness = LED_FADE_LEVEL_MAX / 2;
+    bool leds_on = false;
 
-    uint16_t cc = PWM_TOP / 2;
-
-    gpio_set_irq_enabled_with_callback(ROT_A, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &gpio_handler);
-    gpio_set_irq_enabled_with_callback(ROT_B, GPIO_IRQ_EDGE_FALL | GPIO_IRQ_EDGE_RISE, true, &gpio_handler);
+    init_encoder();
 
     bool prev_rot_sw_state = !gpio_get(ROT_SW);
 
@@ -145,30 +139,24 @@ int main(void)
             busy_wait_ms(DEBOUNCE_DELAY_MS);
             prev_rot_sw_state = rot_sw_state;
             if(rot_sw_state) {
-                toggle_leds(&leds_on, &cc);
+                toggle_leds(&leds_on, &brightness);
             }
         }
 
-        while(queue_try_remove(&events_clockwise, &clockwise) && leds_on) {
-            cc += CC_STEP;
-            if(cc > PWM_TOP) {
-                cc = PWM_TOP;
-            }
-            led_brightness_control(cc);
-        }
+        encoder_poll();
+        int32_t steps = encoder_take_steps();
 
-        while(queue_try_remove(&events_counterclockwise, &counterclockwise) && leds_on) {
-            if(cc < CC_STEP) {
-                cc = 0;
-            } else {
-                cc -= CC_STEP;
+        if(steps != 0 && leds_on) {
+            int32_t level = brightness + steps * BRIGHTNESS_STEP;
+            if(level > LED_FADE_LEVEL_MAX) {
+                level = LED_FADE_LEVEL_MAX;
+            } else if(level < 0) {
+                level = 0;
             }
-            led_brightness_control(cc);
+            brightness = level;
+            led_brightness_control(brightness, FADE_STEP_MS);
         }
     }
 
-    queue_free(&events_clockwise);
-    queue_free(&events_counterclockwise);
-
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,238 @@
+#include <string.h>
+#include "lora_at.h"
+#include "hardware/irq.h"
+
+static uart_inst_t *at_uart;
+static uint at_irq;
+
+// Single producer (UART IRQ), single consumer (at_poll)
+static uint8_t rx_buf[AT_RX_BUF_LEN];
+static volatile uint16_t rx_head;
+static volatile uint16_t rx_tail;
+static volatile uint32_t rx_overflows;
+
+// Single producer (at_transmit), single consumer (UART IRQ)
+static uint8_t tx_buf[AT_TX_BUF_LEN];
+static volatile uint16_t tx_head;
+static volatile uint16_t tx_tail;
+
+static char line[AT_LINE_LEN];
+static uint8_t line_pos;
+
+static AtCommand *pending[AT_MAX_PENDING];
+
+static AtStats stats = { .rtt_min_us = UINT32_MAX };
+
+// Moves queued bytes into the TX FIFO and keeps the TX interrupt on only
+// while some are left. The interrupt fires as the FIFO drains past its
+// trigger level, not while it sits empty, so at_transmit() primes it.
+static void at_tx_fill(void)
+{
+    while(tx_tail != tx_head && uart_is_writable(at_uart)) {
+        uart_putc_raw(at_uart, tx_buf[tx_tail]);
+        tx_tail = (tx_tail + 1) & (AT_TX_BUF_LEN - 1);
+    }
+    uart_set_irq_enables(at_uart, true, tx_tail != tx_head);
+}
+
+static void at_uart_irq(void)
+{
+    at_tx_fill();
+
+    while(uart_is_readable(at_uart)) {
+        uint8_t c = uart_getc(at_uart);
+        uint16_t next = (rx_head + 1) & (AT_RX_BUF_LEN - 1);
+        if(next == rx_tail) {
+            rx_overflows++;
+        } else {
+            rx_buf[rx_head] = c;
+            rx_head = next;
+        }
+    }
+}
+
+void at_init(uart_inst_t *uart, uint baud_rate, uint tx_pin, uint rx_pin)
+{
+    at_uart = uart;
+    stats.baud_rate = uart_init(uart, baud_rate);
+
+    gpio_set_function(tx_pin, GPIO_FUNC_UART);
+    gpio_set_function(rx_pin, GPIO_FUNC_UART);
+
+    at_irq = uart == uart0 ? UART0_IRQ : UART1_IRQ;
+    irq_set_exclusive_handler(at_irq, at_uart_irq);
+    irq_set_enabled(at_irq, true);
+    uart_set_irq_enables(uart, true, false);
+}
+
+void at_set_baudrate(uint baud_rate)
+{
+    while(tx_tail != tx_head) {
+        tight_loop_contents();
+    }
+    uart_tx_wait_blocking(at_uart);
+    stats.baud_rate = uart_set_baudrate(at_uart, baud_rate);
+    line_pos = 0;
+}
+
+static bool at_tx_room(size_t len)
+{
+    return len < AT_TX_BUF_LEN - ((tx_head - tx_tail) & (AT_TX_BUF_LEN - 1));
+}
+
+// Queues the command for the TX interrupt. Returns false, leaving the
+// command as it was, if it does not fit yet.
+static bool at_transmit(AtCommand *cmd)
+{
+    size_t len = strlen(cmd->send);
+
+    if(!at_tx_room(len)) {
+        return false;
+    }
+    for(size_t i = 0; i < len; i++) {
+        tx_buf[(tx_head + i) & (AT_TX_BUF_LEN - 1)] = cmd->send[i];
+    }
+    tx_head = (tx_head + len) & (AT_TX_BUF_LEN - 1);
+
+    irq_set_enabled(at_irq, false);
+    at_tx_fill();
+    irq_set_enabled(at_irq, true);
+
+    if(cmd->attempts++ > 0) {
+        stats.retries++;
+    }
+    cmd->sent_us = time_us_32();
+    stats.tx_bytes += len;
+    return true;
+}
+
+static void at_complete(uint8_t slot, AtStatus status)
+{
+    AtCommand *cmd = pending[slot];
+    pending[slot] = NULL;
+
+    if(status == AT_DONE) {
+        uint32_t rtt = time_us_32() - cmd->first_sent_us;
+        stats.completed++;
+        stats.rtt_total_us += rtt;
+        if(rtt < stats.rtt_min_us) {
+            stats.rtt_min_us = rtt;
+        }
+        if(rtt > stats.rtt_max_us) {
+            stats.rtt_max_us = rtt;
+        }
+    } else {
+        stats.failed++;
+    }
+
+    cmd->status = status;
+    if(cmd->callback != NULL) {
+        cmd->callback(cmd);
+    }
+    cmd->response = NULL;
+    cmd->response_len = 0;
+}
+
+bool at_send(AtCommand *cmd, const char *send, const char *match, uint8_t max_attempts, AtCallback callback)
+{
+    return at_send_timeout(cmd, send, match, max_attempts, AT_TIMEOUT_US, callback);
+}
+
+bool at_send_timeout(AtCommand *cmd, const char *send, const char *match, uint8_t max_attempts,
+                     uint32_t timeout_us, AtCallback callback)
+{
+    if(!at_tx_room(strlen(send))) {
+        return false;
+    }
+    for(uint8_t i = 0; i < AT_MAX_PENDING; i++) {
+        if(pending[i] == NULL) {
+            cmd->send = send;
+            cmd->match = match;
+            cmd->max_attempts = max_attempts;
+            cmd->attempts = 0;
+            cmd->timeout_us = timeout_us;
+            cmd->callback = callback;
+            cmd->response = NULL;
+            cmd->response_len = 0;
+            cmd->status = AT_PENDING;
+
+            pending[i] = cmd;
+            at_transmit(cmd);
+            cmd->first_sent_us = cmd->sent_us;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void at_dispatch_line(void)
+{
+    for(uint8_t i = 0; i < AT_MAX_PENDING; i++) {
+        if(pending[i] != NULL && strstr(line, pending[i]->match) != NULL) {
+            // "+VER: ERROR(-1)" names the command too; retry now rather
+            // than after the timeout
+            if(strstr(line, "ERROR") != NULL) {
+                if(pending[i]->attempts >= pending[i]->max_attempts) {
+                    at_complete(i, AT_FAILED);
+                } else if(!at_transmit(pending[i])) {
+                    // Resent from at_poll() once the TX buffer has room
+                    pending[i]->sent_us = time_us_32() - pending[i]->timeout_us - 1;
+                }
+                return;
+            }
+            pending[i]->response = line;
+            pending[i]->response_len = line_pos;
+            at_complete(i, AT_DONE);
+            return;
+        }
+    }
+}
+
+void at_poll(void)
+{
+    while(rx_tail != rx_head) {
+        char c = rx_buf[rx_tail];
+        rx_tail = (rx_tail + 1) & (AT_RX_BUF_LEN - 1);
+        stats.rx_bytes++;
+
+        if(c == '\r' || c == '\n') {
+            if(line_pos > 0) {
+                line[line_pos] = '\0';
+                at_dispatch_line();
+                line_pos = 0;
+            }
+        } else if(line_pos < AT_LINE_LEN - 1) {
+            line[line_pos++] = c;
+        }
+    }
+
+    uint32_t now = time_us_32();
+
+    for(uint8_t i = 0; i < AT_MAX_PENDING; i++) {
+        AtCommand *cmd = pending[i];
+        if(cmd != NULL && now - cmd->sent_us > cmd->timeout_us) {
+            if(cmd->attempts < cmd->max_attempts) {
+                at_transmit(cmd);
+            } else {
+                at_complete(i, AT_FAILED);
+            }
+        }
+    }
+}
+
+void at_get_stats(AtStats *out)
+{
+    *out = stats;
+    out->tx_queued = (tx_head - tx_tail) & (AT_TX_BUF_LEN - 1);
+    out->rx_overflows = rx_overflows;
+}
+
+void at_reset_stats(void)
+{
+    uint32_t baud_rate = stats.baud_rate;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.baud_rate = baud_rate;
+    stats.rtt_min_us = UINT32_MAX;
+    rx_overflows = 0;
+}
@@ -0,0 +1,81 @@
+#ifndef LORA_AT_H
+#define LORA_AT_H
+
+#include "pico/stdlib.h"
+#include "hardware/uart.h"
+
+#define AT_RX_BUF_LEN 256 // must be a power of two
+#define AT_TX_BUF_LEN 256 // must be a power of two, and hold the longest command
+#define AT_LINE_LEN 80
+#define AT_MAX_PENDING 4
+#define AT_TIMEOUT_US 500000
+
+typedef enum AtStatus {
+    AT_IDLE,
+    AT_PENDING,
+    AT_DONE,
+    AT_FAILED
+} AtStatus;
+
+typedef struct AtStats {
+    uint32_t baud_rate;
+    uint32_t completed;
+    uint32_t failed;
+    uint32_t retries;
+    uint32_t rtt_min_us;
+    uint32_t rtt_max_us;
+    uint64_t rtt_total_us;  // over completed commands
+    uint32_t tx_bytes;
+    uint16_t tx_queued;     // waiting for room in the TX FIFO
+    uint32_t rx_bytes;
+    uint32_t rx_overflows;
+} AtStats;
+
+typedef struct AtCommand AtCommand;
+typedef void (*AtCallback)(AtCommand *cmd);
+
+// Owned by the caller and polled for completion. `send` and `match` must stay
+// valid until the command completes, since the command is resent on timeout.
+// `response` borrows the engine's line buffer, which the next received line
+// overwrites. It is set only while the callback runs, so the callback has to
+// copy out whatever it needs; afterwards it is NULL again.
+struct AtCommand {
+    const char *send;
+    const char *match;
+    uint8_t max_attempts;
+    uint8_t attempts;
+    uint32_t timeout_us;
+    uint32_t first_sent_us;
+    uint32_t sent_us;
+    volatile AtStatus status;
+    AtCallback callback;
+    const char *response;
+    uint8_t response_len;
+};
+
+void at_init(uart_inst_t *uart, uint baud_rate, uint tx_pin, uint rx_pin);
+
+// Waits for queued TX to go out, then switches the local UART rate.
+void at_set_baudrate(uint baud_rate);
+
+// Queues a command and returns immediately; the bytes go out from the UART
+// TX interrupt. Returns false when every slot is taken or the TX buffer is
+// too full. Completion is reported through cmd->status and, if given, the
+// callback, both from at_poll(). The callback runs for failures too and
+// should check cmd->status first.
+bool at_send(AtCommand *cmd, const char *send, const char *match, uint8_t max_attempts, AtCallback callback);
+
+// As at_send(), for commands that take longer than AT_TIMEOUT_US to answer
+// (joins and uplinks wait for the radio).
+bool at_send_timeout(AtCommand *cmd, const char *send, const char *match, uint8_t max_attempts,
+                     uint32_t timeout_us, AtCallback callback);
+
+// Assembles received lines, matches them against pending commands and handles
+// timeouts. A matching line that reports an ERROR counts as a failed attempt.
+// Never blocks.
+void at_poll(void);
+
+void at_get_stats(AtStats *stats);
+void at_reset_stats(void);
+
+#endif
@@ -0,0 +1,226 @@
+#include <stdio.h>
+#include <string.h>
+#include "lora_uplink.h"
+#include "lora_at.h"
+
+#define LORAWAN_OVERHEAD 13 // MHDR, FHDR without FOpts, FPort and MIC
+
+typedef struct UplinkRecord {
+    uint8_t len;
+    uint8_t data[UPLINK_RECORD_MAX];
+    uint32_t queued_us;
+} UplinkRecord;
+
+// Regulatory sub-band: after a frame of airtime T it stays closed for
+// T * (duty_inverse - 1), i.e. duty_inverse is 100 for a 1% band.
+typedef struct UplinkBand {
+    uint16_t duty_inverse;
+    uint64_t next_free_us;
+    UplinkBandStats stats;
+} UplinkBand;
+
+typedef enum UplinkState {
+    UPLINK_JOIN,
+    UPLINK_JOINING,
+    UPLINK_JOIN_WAIT,
+    UPLINK_READY,
+    UPLINK_SENDING
+} UplinkState;
+
+// The module's default EU868 channels (868.1, 868.3, 868.5 MHz) all fall in
+// the 868.0-868.6 MHz sub-band
+static UplinkBand bands[UPLINK_BAND_COUNT] = {
+    { .duty_inverse = 100 },
+};
+
+static UplinkRecord queue[UPLINK_QUEUE_LEN];
+static uint8_t queue_head;
+static uint8_t queue_count;
+
+// Packed frame kept until it has been sent, so a failed uplink is retried
+// in the next window instead of losing its records
+static uint8_t frame[UPLINK_MAX_PAYLOAD];
+static uint8_t frame_len;
+static uint8_t frame_records;
+static uint32_t frame_airtime_us;
+static char frame_cmd[sizeof("AT+MSGHEX=\"\"\r\n") + 2 * UPLINK_MAX_PAYLOAD];
+
+static UplinkState state = UPLINK_JOIN;
+static uint64_t join_retry_us;
+static AtCommand cmd = { .status = AT_IDLE };
+
+static UplinkStats stats;
+
+bool uplink_queue(const uint8_t *data, uint8_t len)
+{
+    if(len == 0 || len > UPLINK_RECORD_MAX || queue_count == UPLINK_QUEUE_LEN) {
+        stats.dropped++;
+        return false;
+    }
+
+    UplinkRecord *record = &queue[(queue_head + queue_count) % UPLINK_QUEUE_LEN];
+    record->len = len;
+    memcpy(record->data, data, len);
+    record->queued_us = time_us_32();
+
+    queue_count++;
+    stats.queued++;
+    if(queue_count > stats.queue_peak) {
+        stats.queue_peak = queue_count;
+    }
+    return true;
+}
+
+uint32_t uplink_airtime_us(uint8_t payload_len)
+{
+    // Semtech AN1200.13 with BW 125 kHz, CR 4/5, explicit header, CRC on and
+    // an 8 symbol preamble. Low data rate optimisation is on for SF11 and SF12.
+    const int32_t t_sym_us = (1 << UPLINK_SF) * 8;
+    const int32_t de = UPLINK_SF >= 11 ? 1 : 0;
+    int32_t num = 8 * (payload_len + LORAWAN_OVERHEAD) - 4 * UPLINK_SF + 28 + 16;
+    int32_t den = 4 * (UPLINK_SF - 2 * de);
+    int32_t symbols = 8;
+
+    if(num > 0) {
+        symbols += (num + den - 1) / den * 5;
+    }
+    return 49 * t_sym_us / 4 + symbols * t_sym_us;
+}
+
+static bool uplink_should_send(uint32_t now)
+{
+    if(frame_len > 0) {
+        return true;
+    }
+    if(queue_count == 0) {
+        return false;
+    }
+
+    // Hold small records back until they fill a frame or the oldest one
+    // has waited long enough
+    uint16_t pending = 0;
+    for(uint8_t i = 0; i < queue_count && pending < UPLINK_MAX_PAYLOAD; i++) {
+        pending += 1 + queue[(queue_head + i) % UPLINK_QUEUE_LEN].len;
+    }
+    return pending >= UPLINK_MAX_PAYLOAD || now - queue[queue_head].queued_us >= UPLINK_MAX_HOLD_US;
+}
+
+static void uplink_pack(void)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    frame_len = 0;
+    frame_records = 0;
+    while(queue_count > 0) {
+        UplinkRecord *record = &queue[queue_head];
+        if(frame_len + 1 + record->len > UPLINK_MAX_PAYLOAD) {
+            break;
+        }
+        frame[frame_len++] = record->len;
+        memcpy(&frame[frame_len], record->data, record->len);
+        frame_len += record->len;
+        frame_records++;
+
+        queue_head = (queue_head + 1) % UPLINK_QUEUE_LEN;
+        queue_count--;
+    }
+
+    char *p = frame_cmd + sprintf(frame_cmd, "AT+MSGHEX=\"");
+    for(uint8_t i = 0; i < frame_len; i++) {
+        *p++ = hex[frame[i] >> 4];
+        *p++ = hex[frame[i] & 0x0F];
+    }
+    strcpy(p, "\"\r\n");
+
+    frame_airtime_us = uplink_airtime_us(frame_len);
+}
+
+// Returns the index of the sub-band that has been open the longest, or -1 if
+// every band is still inside its off period
+static int uplink_pick_band(uint64_t now)
+{
+    int best = -1;
+
+    for(uint8_t i = 0; i < UPLINK_BAND_COUNT; i++) {
+        if(bands[i].next_free_us <= now && (best < 0 || bands[i].next_free_us < bands[best].next_free_us)) {
+            best = i;
+        }
+    }
+    return best;
+}
+
+void uplink_poll(void)
+{
+    uint64_t now = time_us_64();
+
+    switch(state) {
+        case UPLINK_JOIN:
+            if(at_send_timeout(&cmd, "AT+JOIN\r\n", "joined", 1, UPLINK_JOIN_TIMEOUT_US, NULL)) {
+                state = UPLINK_JOINING;
+            }
+            break;
+        case UPLINK_JOINING:
+            if(cmd.status == AT_DONE) {
+                cmd.status = AT_IDLE;
+                stats.joined = true;
+                state = UPLINK_READY;
+            } else if(cmd.status == AT_FAILED) {
+                cmd.status = AT_IDLE;
+                join_retry_us = now + UPLINK_JOIN_RETRY_US;
+                state = UPLINK_JOIN_WAIT;
+            }
+            break;
+        case UPLINK_JOIN_WAIT:
+            if(now >= join_retry_us) {
+                state = UPLINK_JOIN;
+            }
+            break;
+        case UPLINK_READY: {
+            if(!uplink_should_send((uint32_t) now)) {
+                break;
+            }
+            int band = uplink_pick_band(now);
+            if(band < 0) {
+                break;
+            }
+            if(frame_len == 0) {
+                uplink_pack();
+            }
+            if(at_send_timeout(&cmd, frame_cmd, "MSGHEX: Done", 1, UPLINK_SEND_TIMEOUT_US, NULL)) {
+                // Charge the band as soon as the frame goes out. A timed out
+                // uplink may still have been transmitted.
+                bands[band].next_free_us = now + (uint64_t) frame_airtime_us * bands[band].duty_inverse;
+                bands[band].stats.frames++;
+                bands[band].stats.airtime_us += frame_airtime_us;
+                state = UPLINK_SENDING;
+            }
+            break;
+        }
+        case UPLINK_SENDING:
+            if(cmd.status == AT_DONE) {
+                cmd.status = AT_IDLE;
+                stats.frames_sent++;
+                stats.records_sent += frame_records;
+                stats.payload_bytes += frame_len;
+                frame_len = 0;
+                state = UPLINK_READY;
+            } else if(cmd.status == AT_FAILED) {
+                cmd.status = AT_IDLE;
+                stats.frames_failed++;
+                state = UPLINK_READY;
+            }
+            break;
+    }
+}
+
+void uplink_get_stats(UplinkStats *out)
+{
+    uint64_t now = time_us_64();
+
+    stats.queue_depth = queue_count;
+    for(uint8_t i = 0; i < UPLINK_BAND_COUNT; i++) {
+        bands[i].stats.wait_us = bands[i].next_free_us > now ? bands[i].next_free_us - now : 0;
+        stats.bands[i] = bands[i].stats;
+    }
+    *out = stats;
+}
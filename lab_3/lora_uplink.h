@@ -0,0 +1,48 @@
+#ifndef LORA_UPLINK_H
+#define LORA_UPLINK_H
+
+#include "pico/stdlib.h"
+
+#define UPLINK_QUEUE_LEN 16
+#define UPLINK_RECORD_MAX 16
+#define UPLINK_MAX_PAYLOAD 51       // EU868 DR0, the worst case the module may pick
+#define UPLINK_SF 12
+#define UPLINK_MAX_HOLD_US 60000000 // send a partial frame once its oldest record is this old
+#define UPLINK_JOIN_TIMEOUT_US 20000000
+#define UPLINK_SEND_TIMEOUT_US 10000000
+#define UPLINK_JOIN_RETRY_US 30000000
+#define UPLINK_BAND_COUNT 1         // sub-bands covered by the module's enabled channels
+
+typedef struct UplinkBandStats {
+    uint32_t frames;
+    uint64_t airtime_us;
+    uint32_t wait_us;   // time left before the band may be used again
+} UplinkBandStats;
+
+typedef struct UplinkStats {
+    bool joined;
+    uint8_t queue_depth;
+    uint8_t queue_peak;
+    uint32_t queued;
+    uint32_t dropped;       // queue full or record too long
+    uint32_t records_sent;
+    uint32_t frames_sent;
+    uint32_t frames_failed;
+    uint32_t payload_bytes; // application bytes, including the per-record length prefix
+    UplinkBandStats bands[UPLINK_BAND_COUNT];
+} UplinkStats;
+
+// Copies a record of up to UPLINK_RECORD_MAX bytes into the queue. Records are
+// coalesced into frames, each prefixed with its length byte.
+bool uplink_queue(const uint8_t *data, uint8_t len);
+
+// Joins when needed, packs queued records into a frame and sends it once the
+// duty cycle of its sub-band allows. Call after at_poll(); never blocks.
+void uplink_poll(void);
+
+// LoRa time on air for a LoRaWAN frame carrying `payload_len` application bytes
+uint32_t uplink_airtime_us(uint8_t payload_len);
+
+void uplink_get_stats(UplinkStats *stats);
+
+#endif
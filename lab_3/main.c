@@ -1,132 +1,228 @@
 #include <stdio.h>
+#include <stddef.h>
 #include <string.h>
-#include <stdlib.h>
 #include <ctype.h>
 #include "pico/stdlib.h"
 #include "hardware/gpio.h"
 #include "hardware/uart.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "lora_at.h"
+#include "lora_uplink.h"
+#include "crc16.h"
 
-#define SW_0 9
+#define SW_0 9 // identify the module
+#define SW_1 8 // queue an uplink event
+#define SW_DEBOUNCE_US 20000 // level must hold this long before it counts
 
 #define UART_ID uart1
 #define BAUD_RATE 9600
+#define FAST_BAUD_RATE 115200
+#define FAST_BAUD_CMD "AT+UART=BR, 115200\r\n"
 #define UART_TX_PIN 4
 #define UART_RX_PIN 5
 
-#define STR_LEN (80)
 #define LORA_ID_LEN (16)
-#define UART_TIMEOUT_US 500000
+#define LORA_VER_LEN (32)
+
+// Last flash sector, well past the program image
+#define IDENTITY_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define IDENTITY_MAGIC 0x4C6F5261
 
 typedef enum LoRaState {
     STATE_IDLE,
     STATE_CONNECTING,
+    STATE_UPSHIFT_SET,
+    STATE_UPSHIFT_RESET,
+    STATE_UPSHIFT_VERIFY,
     STATE_READING_FIRMWARE,
     STATE_READING_DEVEUI,
     STATE_ERROR
 } LoRaState;
 
-char *uart_read_string_with_timeout(uart_inst_t *uart, const char *desired_output, uint8_t max_attempts)
+typedef struct Switch {
+    uint pin;
+    bool pressed;        // debounced
+    bool level;          // as last sampled
+    uint64_t level_since_us;
+} Switch;
+
+typedef struct LoRaIdentity {
+    uint32_t magic;
+    char fw_version[LORA_VER_LEN];
+    char deveui[LORA_ID_LEN + 1];
+    uint16_t crc;
+} LoRaIdentity;
+
+static LoRaIdentity identity;
+static bool identity_cached = false;
+static uint32_t identity_hits = 0;
+static uint32_t identity_misses = 0;
+
+bool identity_load(void)
 {
-    uint32_t t = 0;
-    uint8_t pos = 0;
-    uint8_t attempt = 0;
+    const LoRaIdentity *stored = (const LoRaIdentity *) (XIP_BASE + IDENTITY_FLASH_OFFSET);
 
-    char *str = (char *) malloc(STR_LEN * sizeof(char));
-    if(str == NULL) {
-        return NULL;
+    if(stored->magic != IDENTITY_MAGIC ||
+       stored->crc != crc16((const uint8_t *) stored, offsetof(LoRaIdentity, crc))) {
+        return false;
     }
+    identity = *stored;
+    return true;
+}
 
-    for(attempt = 0; attempt < max_attempts; attempt++) {
-        pos = 0;
-        t = time_us_32();
-
-        do {
-            if(uart_is_readable(uart)) {
-                char c = uart_getc(uart);
-                if(c == '\r' || c == '\n') {
-                    str[pos] = '\0';
-                    if(strstr(str, desired_output) != NULL) {
-                        return str;
-                    }
-                    break;
-                } else {
-                    if(pos < STR_LEN - 1) {
-                        str[pos++] = c;
-                    }
-                }
-            }
-        } while((time_us_32() - t) <= UART_TIMEOUT_US);
+void identity_store(void)
+{
+    uint8_t page[FLASH_PAGE_SIZE];
 
-        if(attempt == max_attempts - 1) {
-            break;
-        }
+    identity.magic = IDENTITY_MAGIC;
+    identity.crc = crc16((const uint8_t *) &identity, offsetof(LoRaIdentity, crc));
+
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &identity, sizeof(identity));
+
+    uint32_t ints = save_and_disable_interrupts();
+    flash_range_erase(IDENTITY_FLASH_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(IDENTITY_FLASH_OFFSET, page, FLASH_PAGE_SIZE);
+    restore_interrupts(ints);
+}
+
+void lora_print_connected(AtCommand *cmd)
+{
+    if(cmd->status != AT_DONE) {
+        return;
     }
+    printf("Connected to LoRa module.\n");
+}
 
-    free(str);
-    return NULL;
+void lora_print_fw_version(AtCommand *cmd)
+{
+    if(cmd->status != AT_DONE) {
+        return;
+    }
+    uint8_t len = cmd->response_len < LORA_VER_LEN - 1 ? cmd->response_len : LORA_VER_LEN - 1;
+
+    memcpy(identity.fw_version, cmd->response, len);
+    identity.fw_version[len] = '\0';
+    printf("%s\n", identity.fw_version);
 }
 
+// Reads the hex digits after ", " in "+ID: DevEui, 2C:F7:...". The input is a
+// borrowed view and need not be terminated; output holds LORA_ID_LEN + 1 chars.
+bool lora_fmt_deveui(const char *input, size_t len, char *output)
+{
+    size_t i = 0;
+    uint8_t j = 0;
+
+    while(i + 1 < len && !(input[i] == ',' && input[i + 1] == ' ')) {
+        i++;
+    }
 
-bool lora_test_uart_connection(uart_inst_t *uart)
+    if(i + 1 < len) {
+        for(i += 2; i < len && j < LORA_ID_LEN; i++) {
+            if(isxdigit((unsigned char) input[i])) {
+                output[j++] = tolower((unsigned char) input[i]);
+            }
+        }
+    }
+    output[j] = '\0';
+    return j == LORA_ID_LEN;
+}
+
+// A DevEui with digits missing is not kept, so it never reaches the cache
+void lora_print_deveui(AtCommand *cmd)
 {
-    const char *send = "AT\r\n";
-
-    uart_write_blocking(uart, (uint8_t *) send, strlen(send));
-    char *received_string = uart_read_string_with_timeout(uart, "OK", 5);
-    if(received_string != NULL) {
-        printf("Connected to LoRa module.\n");;
-        free(received_string);
-        return true;
+    if(cmd->status != AT_DONE) {
+        return;
+    }
+    if(lora_fmt_deveui(cmd->response, cmd->response_len, identity.deveui)) {
+        printf("%s\n", identity.deveui);
     } else {
-        return false;
+        identity.deveui[0] = '\0';
     }
 }
 
-bool lora_get_fw_version(uart_inst_t *uart)
+void lora_print_stats(void)
 {
-    const char *send = "AT+VER\r\n";
-
-    uart_write_blocking(uart, (uint8_t *) send, strlen(send));
-    char *received_string = uart_read_string_with_timeout(uart, "VER", 2);
-    if(received_string != NULL) {
-        printf("%s\n", received_string);
-        free(received_string);
-        return true;
-    } else {
-        return false;
+    AtStats stats;
+    at_get_stats(&stats);
+
+    uint32_t rtt_avg = stats.completed ? stats.rtt_total_us / stats.completed : 0;
+    printf("AT @ %lu baud: %lu ok, %lu failed, %lu retries, rtt min/avg/max %lu/%lu/%lu us, %lu B out, %lu B in, %lu dropped\n",
+           stats.baud_rate, stats.completed, stats.failed, stats.retries,
+           stats.completed ? stats.rtt_min_us : 0, rtt_avg, stats.rtt_max_us,
+           stats.tx_bytes, stats.rx_bytes, stats.rx_overflows);
+    printf("Identity cache: %lu hits, %lu misses\n", identity_hits, identity_misses);
+}
+
+void lora_print_uplink_stats(void)
+{
+    UplinkStats stats;
+    uplink_get_stats(&stats);
+
+    printf("Uplink%s: queue %u (peak %u), %lu queued, %lu dropped, %lu records in %lu frames, %lu failed, %lu B\n",
+           stats.joined ? "" : " (not joined)", stats.queue_depth, stats.queue_peak,
+           stats.queued, stats.dropped, stats.records_sent, stats.frames_sent, stats.frames_failed,
+           stats.payload_bytes);
+    for(uint8_t i = 0; i < UPLINK_BAND_COUNT; i++) {
+        printf("Sub-band %u: %lu frames, %lu ms airtime, free in %lu ms\n", i, stats.bands[i].frames,
+               (uint32_t) (stats.bands[i].airtime_us / 1000), stats.bands[i].wait_us / 1000);
+    }
+}
+
+// Queues a small event record: press count and uptime in seconds, big-endian
+void lora_queue_press(uint16_t press_count)
+{
+    uint32_t uptime = to_ms_since_boot(get_absolute_time()) / 1000;
+    uint8_t record[] = {
+        press_count >> 8, press_count,
+        uptime >> 24, uptime >> 16, uptime >> 8, uptime
+    };
+
+    if(!uplink_queue(record, sizeof(record))) {
+        printf("Uplink queue full, event dropped.\n");
     }
+    lora_print_uplink_stats();
 }
 
-void lora_fmt_deveui(char *input, char *output)
+// Drives one AT command per state without blocking: sends it on the first call,
+// then stays in `state` until the response arrives or all attempts time out.
+LoRaState lora_run_command(AtCommand *cmd, const char *send, const char *match, uint8_t max_attempts,
+                           AtCallback callback, LoRaState state, LoRaState next)
 {
-    char *start = strstr(input, ", ");
-    if(start != NULL) {
-        start += 2;
-        uint8_t j = 0;
-        for(uint8_t i = 0; start[i] != '\0'; i++) {
-            if(isxdigit(start[i])) {
-                output[j++] = tolower(start[i]);
+    switch(cmd->status) {
+        case AT_IDLE:
+            if(!at_send(cmd, send, match, max_attempts, callback)) {
+                return STATE_ERROR;
             }
-        }
-        output[j] = '\0';
+            break;
+        case AT_PENDING:
+            break;
+        case AT_DONE:
+            cmd->status = AT_IDLE;
+            return next;
+        case AT_FAILED:
+            cmd->status = AT_IDLE;
+            return STATE_ERROR;
     }
+    return state;
 }
 
-bool lora_get_deveui(uart_inst_t *uart)
+// True once per press, when the switch has been let go. Contact chatter
+// never holds a level for SW_DEBOUNCE_US, so it is not seen at all.
+static bool switch_released(Switch *sw, uint64_t now)
 {
-    const char *send = "AT+ID=DevEui\r\n";
-    char lora_deveui[LORA_ID_LEN + 1];
-
-    uart_write_blocking(uart, (uint8_t *) send, strlen(send));
-    char *received_string = uart_read_string_with_timeout(uart, "ID", 2);
-    if(received_string != NULL) {
-        lora_fmt_deveui(received_string, lora_deveui);
-        printf("%s\n", lora_deveui);
-        free(received_string);
-        return true;
-    } else {
-        return false;
+    bool level = !gpio_get(sw->pin);
+
+    if(level != sw->level) {
+        sw->level = level;
+        sw->level_since_us = now;
+    }
+    if(level != sw->pressed && now - sw->level_since_us >= SW_DEBOUNCE_US) {
+        sw->pressed = level;
+        return !level;
     }
+    return false;
 }
 
 int main(void)
@@ -138,46 +234,138 @@ int main(void)
     gpio_set_dir(SW_0, GPIO_IN);
     gpio_pull_up(SW_0);
 
-    uart_init(UART_ID, BAUD_RATE);
+    gpio_init(SW_1);
+    gpio_set_dir(SW_1, GPIO_IN);
+    gpio_pull_up(SW_1);
 
-    gpio_set_function(UART_TX_PIN, GPIO_FUNC_UART);
-    gpio_set_function(UART_RX_PIN, GPIO_FUNC_UART);
+    at_init(UART_ID, BAUD_RATE, UART_TX_PIN, UART_RX_PIN);
+
+    identity_cached = identity_load();
+    if(identity_cached) {
+        printf("Cached module identity found.\n");
+    }
 
     LoRaState state = STATE_IDLE;
+    AtCommand cmd = { .status = AT_IDLE };
+
+    uint lora_baud = BAUD_RATE;
+    bool upshift_tried = false;
+    bool other_rate_probed = false;
+
+    bool lora_ready = false;
+    uint16_t press_count = 0;
+
+    Switch sw0 = { .pin = SW_0 };
+    Switch sw1 = { .pin = SW_1 };
 
     while(true) {
+        at_poll();
+
+        // One action per press; for SW_1 that is one uplink record and its airtime
+        uint64_t now = time_us_64();
+        bool sw0_released = switch_released(&sw0, now);
+        bool sw1_released = switch_released(&sw1, now);
+
         switch(state) {
             case STATE_IDLE:
-                if(!gpio_get(SW_0)) {
-                    while(!gpio_get(SW_0)) {
-                        sleep_ms(50);
-                    }
+                // Identification goes through the "AT" probe every time and
+                // is then served from the cache
+                if(sw0_released) {
                     state = STATE_CONNECTING;
+                    break;
+                }
+                if(sw1_released) {
+                    if(lora_ready) {
+                        lora_queue_press(++press_count);
+                    } else {
+                        printf("Identify the module first.\n");
+                    }
+                }
+                if(lora_ready) {
+                    uplink_poll();
                 }
                 break;
             case STATE_CONNECTING:
-                if(lora_test_uart_connection(UART_ID)) {
+                state = lora_run_command(&cmd, "AT\r\n", "OK", 5, lora_print_connected, state,
+                                         upshift_tried || lora_baud == FAST_BAUD_RATE ?
+                                         STATE_READING_FIRMWARE : STATE_UPSHIFT_SET);
+                if(state == STATE_ERROR && !other_rate_probed) {
+                    // The module keeps its UART rate across resets, so it may still
+                    // be at the other rate from an earlier session.
+                    other_rate_probed = true;
+                    lora_baud = lora_baud == BAUD_RATE ? FAST_BAUD_RATE : BAUD_RATE;
+                    at_set_baudrate(lora_baud);
+                    state = STATE_CONNECTING;
+                } else if(state != STATE_CONNECTING) {
+                    other_rate_probed = false;
+                }
+                break;
+            case STATE_UPSHIFT_SET:
+                upshift_tried = true;
+                state = lora_run_command(&cmd, FAST_BAUD_CMD, "UART", 2, NULL,
+                                         state, STATE_UPSHIFT_RESET);
+                if(state == STATE_ERROR) {
+                    printf("Baud rate change rejected, staying at %d.\n", lora_baud);
                     state = STATE_READING_FIRMWARE;
-                } else {
-                    state = STATE_ERROR;
+                }
+                break;
+            case STATE_UPSHIFT_RESET:
+                // The new rate takes effect after the module restarts
+                state = lora_run_command(&cmd, "AT+RESET\r\n", "RESET", 2, NULL,
+                                         state, STATE_UPSHIFT_VERIFY);
+                if(state == STATE_UPSHIFT_VERIFY) {
+                    lora_baud = FAST_BAUD_RATE;
+                    at_set_baudrate(lora_baud);
+                } else if(state == STATE_ERROR) {
+                    state = STATE_READING_FIRMWARE;
+                }
+                break;
+            case STATE_UPSHIFT_VERIFY:
+                state = lora_run_command(&cmd, "AT\r\n", "OK", 5, NULL,
+                                         state, STATE_READING_FIRMWARE);
+                if(state == STATE_READING_FIRMWARE) {
+                    printf("UART running at %d baud.\n", lora_baud);
+                } else if(state == STATE_ERROR) {
+                    // Dropping only our side to 9600 would leave the module at
+                    // the new rate. Probe again from here instead; if it stays
+                    // quiet, CONNECTING tries the other rate, and upshift_tried
+                    // keeps it from going round again.
+                    printf("No response at %d baud, probing again.\n", lora_baud);
+                    state = STATE_CONNECTING;
                 }
                 break;
             case STATE_READING_FIRMWARE:
-                if(lora_get_fw_version(UART_ID)) {
-                    state = STATE_READING_DEVEUI;
-                } else {
-                    state = STATE_ERROR;
+                // Version and DevEui never change for a module, so once the "AT"
+                // probe has answered they are served from the cache.
+                if(identity_cached) {
+                    identity_hits++;
+                    printf("%s\n%s\n", identity.fw_version, identity.deveui);
+                    lora_print_stats();
+                    lora_ready = true;
+                    state = STATE_IDLE;
+                    break;
+                }
+                if(cmd.status == AT_IDLE) {
+                    identity_misses++;
                 }
+                state = lora_run_command(&cmd, "AT+VER\r\n", "VER", 2, lora_print_fw_version,
+                                         state, STATE_READING_DEVEUI);
                 break;
             case STATE_READING_DEVEUI:
-                if(lora_get_deveui(UART_ID)) {
-                    state = STATE_IDLE;
-                } else {
-                    state = STATE_ERROR;
+                state = lora_run_command(&cmd, "AT+ID=DevEui\r\n", "ID", 2, lora_print_deveui,
+                                         state, STATE_IDLE);
+                if(state == STATE_IDLE) {
+                    if(identity.deveui[0] != '\0') {
+                        identity_store();
+                        identity_cached = true;
+                    }
+                    lora_print_stats();
+                    lora_ready = true;
                 }
                 break;
             case STATE_ERROR:
                 printf("Module not responding.\n");
+                lora_print_stats();
                 state = STATE_IDLE;
                 break;
         }
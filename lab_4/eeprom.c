@@ -0,0 +1,704 @@
+#include <string.h>
+#include "eeprom.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#define PROBE_LEN 16
+
+typedef enum EepromOp {
+    EEPROM_OP_WRITE,
+    EEPROM_OP_READ,
+    EEPROM_OP_READ_CURRENT // continues from the part's address counter
+} EepromOp;
+
+typedef enum EepromStatus {
+    EEPROM_QUEUED,
+    EEPROM_ACTIVE,
+    EEPROM_DONE,
+    EEPROM_FAILED
+} EepromStatus;
+
+typedef struct EepromRequest {
+    EepromOp op;
+    uint16_t address;
+    uint16_t len;
+    uint8_t data[PAGE_SIZE]; // write payload, copied when queued
+    uint8_t *buffer;         // read destination
+    EepromCallback callback;
+    void *ctx;
+    volatile EepromStatus status;
+    bool stalled;
+    bool aborted;            // NACKed, waiting for the STOP that follows
+    bool overlay;            // cached data goes over the buffer when retired
+    uint32_t queued_us;
+    uint32_t first_attempt_us;
+    uint32_t attempt_us;
+} EepromRequest;
+
+static i2c_inst_t *eeprom_i2c;
+static uint eeprom_irq;
+static uint tx_chan;
+static uint rx_chan;
+static dma_channel_config tx_config;
+static dma_channel_config rx_config;
+static bool async_writes;
+
+// Requests move submit -> active (I2C IRQ) -> retire (eeprom_poll). Free
+// running counters; EEPROM_QUEUE_LEN divides 256.
+static EepromRequest queue[EEPROM_QUEUE_LEN];
+static uint8_t q_submit;
+static volatile uint8_t q_active;
+static uint8_t q_retire;
+static volatile bool engine_busy;
+
+// Command words for the transfer in flight, address included; only one is
+// active at a time
+static uint16_t tx_words[2 + EEPROM_SCAN_CHUNK];
+
+// Set while the part is running an internal write cycle
+static volatile bool write_pending;
+static volatile uint32_t write_done_us;
+
+static EepromStats stats = { .busy_min_us = UINT32_MAX, .latency_min_us = UINT32_MAX };
+static uint64_t stats_since_us;
+
+// Write-back cache of whole pages. `valid` and `dirty` have one bit per byte,
+// so a partial page write never needs the rest of the page read first.
+typedef struct CacheLine {
+    uint16_t page;
+    uint64_t valid;
+    uint64_t dirty;
+    uint32_t dirty_since_us;
+    uint32_t last_write_us;
+    uint32_t last_use_us;
+    uint8_t data[PAGE_SIZE];
+    volatile bool filling;   // gap fill read queued, the write follows it
+    uint8_t fill[PAGE_SIZE];
+} CacheLine;
+
+static CacheLine cache[EEPROM_CACHE_LINES];
+
+static uint64_t byte_mask(size_t offset, size_t len)
+{
+    return (len >= 64 ? ~0ULL : (1ULL << len) - 1) << offset;
+}
+
+static CacheLine *cache_find(uint16_t page)
+{
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        if(cache[i].valid != 0 && cache[i].page == page) {
+            return &cache[i];
+        }
+    }
+    return NULL;
+}
+
+// Copies whatever the cache holds for [address, address + len) over buffer
+static void cache_overlay(uint16_t address, uint8_t *buffer, size_t len)
+{
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        CacheLine *line = &cache[i];
+        if(line->valid == 0 || line->page + PAGE_SIZE <= address || line->page >= address + len) {
+            continue;
+        }
+        for(uint8_t j = 0; j < PAGE_SIZE; j++) {
+            uint16_t a = line->page + j;
+            if(a >= address && a < address + len && (line->valid & (1ULL << j))) {
+                buffer[a - address] = line->data[j];
+            }
+        }
+    }
+}
+
+static void eeprom_attempt(EepromRequest *req)
+{
+    i2c_hw_t *hw = i2c_get_hw(eeprom_i2c);
+    uint16_t n = 0;
+
+    req->attempt_us = time_us_32();
+
+    // The whole transfer goes by DMA, address first. A read command after
+    // the address makes the controller issue a restart.
+    if(req->op != EEPROM_OP_READ_CURRENT) {
+        tx_words[n++] = req->address >> 8;
+        tx_words[n++] = req->address & 0xFF;
+    }
+    if(req->op == EEPROM_OP_WRITE) {
+        for(uint16_t i = 0; i < req->len; i++) {
+            tx_words[n++] = req->data[i];
+        }
+    } else {
+        for(uint16_t i = 0; i < req->len; i++) {
+            tx_words[n++] = I2C_IC_DATA_CMD_CMD_BITS;
+        }
+        dma_channel_configure(rx_chan, &rx_config, req->buffer, &hw->data_cmd, req->len, true);
+    }
+    tx_words[n - 1] |= I2C_IC_DATA_CMD_STOP_BITS;
+    dma_channel_configure(tx_chan, &tx_config, &hw->data_cmd, tx_words, n, true);
+}
+
+static void eeprom_start_next(void)
+{
+    if(q_active == q_submit) {
+        engine_busy = false;
+        return;
+    }
+
+    EepromRequest *req = &queue[q_active % EEPROM_QUEUE_LEN];
+    engine_busy = true;
+    req->status = EEPROM_ACTIVE;
+    req->first_attempt_us = time_us_32();
+    eeprom_attempt(req);
+}
+
+static void eeprom_finish(EepromRequest *req, EepromStatus status, uint32_t now)
+{
+    uint32_t latency = now - req->queued_us;
+
+    stats.requests++;
+    stats.latency_total_us += latency;
+    if(latency < stats.latency_min_us) {
+        stats.latency_min_us = latency;
+    }
+    if(latency > stats.latency_max_us) {
+        stats.latency_max_us = latency;
+    }
+
+    req->status = status;
+    q_active++;
+    eeprom_start_next();
+}
+
+static void eeprom_i2c_irq(void)
+{
+    i2c_hw_t *hw = i2c_get_hw(eeprom_i2c);
+    uint32_t status = hw->raw_intr_stat;
+    EepromRequest *req = &queue[q_active % EEPROM_QUEUE_LEN];
+    uint32_t now = time_us_32();
+
+    if(!engine_busy) {
+        (void) hw->clr_intr;
+        return;
+    }
+
+    // The controller still sends a STOP after an abort. Nothing is touched
+    // until it has, or its STOP_DET would end the retry early.
+    if(status & I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS) {
+        dma_channel_abort(tx_chan);
+        dma_channel_abort(rx_chan);
+        (void) hw->clr_tx_abrt;
+        req->aborted = true;
+    }
+    if(!(status & I2C_IC_RAW_INTR_STAT_STOP_DET_BITS)) {
+        return;
+    }
+    (void) hw->clr_stop_det;
+    stats.bus_busy_us += now - req->attempt_us;
+
+    if(req->aborted) {
+        req->aborted = false;
+        // The part does not ACK its address until a write cycle is over, so a
+        // NACK then is just ACK polling: try again until it answers.
+        if(write_pending && now - write_done_us <= EEPROM_WRITE_TIMEOUT_US) {
+            req->stalled = true;
+            eeprom_attempt(req);
+            return;
+        }
+        if(write_pending) {
+            stats.timeouts++;
+            write_pending = false;
+        }
+        eeprom_finish(req, EEPROM_FAILED, now);
+        return;
+    }
+
+    if(req->op != EEPROM_OP_WRITE) {
+        dma_channel_wait_for_finish_blocking(rx_chan);
+    }
+
+    // If the first attempt was ACKed the cycle ended at some unknown point
+    // before it, so only writes seen finishing count towards the busy time.
+    if(write_pending && req->stalled) {
+        uint32_t busy = req->attempt_us - write_done_us;
+        stats.measured++;
+        stats.busy_total_us += busy;
+        if(busy < stats.busy_min_us) {
+            stats.busy_min_us = busy;
+        }
+        if(busy > stats.busy_max_us) {
+            stats.busy_max_us = busy;
+        }
+        stats.stalls++;
+        stats.stall_total_us += req->attempt_us - req->first_attempt_us;
+    }
+    write_pending = false;
+
+    if(req->op == EEPROM_OP_WRITE) {
+        write_pending = true;
+        write_done_us = now;
+        stats.writes++;
+        stats.bytes_written += req->len;
+    }
+    eeprom_finish(req, EEPROM_DONE, now);
+}
+
+// Hands completed requests back to their owners. Main loop context only.
+// The slot is freed before the callback runs, since the callback may queue
+// more requests and so retire again.
+static void eeprom_retire(void)
+{
+    while(q_retire != q_active) {
+        EepromRequest *req = &queue[q_retire % EEPROM_QUEUE_LEN];
+        EepromCallback callback = req->callback;
+        void *ctx = req->ctx;
+        bool ok = req->status == EEPROM_DONE;
+
+        if(ok && req->overlay) {
+            cache_overlay(req->address, req->buffer, req->len);
+        }
+        q_retire++;
+        if(callback != NULL) {
+            callback(ok, ctx);
+        }
+    }
+}
+
+static EepromRequest *eeprom_queue(EepromOp op, uint16_t address, uint16_t len, uint8_t *buffer,
+                                   EepromCallback callback, void *ctx)
+{
+    if((uint8_t) (q_submit - q_retire) == EEPROM_QUEUE_LEN) {
+        eeprom_retire();
+        if((uint8_t) (q_submit - q_retire) == EEPROM_QUEUE_LEN) {
+            return NULL;
+        }
+    }
+
+    EepromRequest *req = &queue[q_submit % EEPROM_QUEUE_LEN];
+    req->op = op;
+    req->address = address;
+    req->len = len;
+    req->buffer = buffer;
+    req->callback = callback;
+    req->ctx = ctx;
+    req->stalled = false;
+    req->aborted = false;
+    req->overlay = false;
+    req->status = EEPROM_QUEUED;
+    req->queued_us = time_us_32();
+    return req;
+}
+
+static void eeprom_commit(void)
+{
+    irq_set_enabled(eeprom_irq, false);
+    q_submit++;
+    uint8_t depth = q_submit - q_retire;
+    if(depth > stats.queue_peak) {
+        stats.queue_peak = depth;
+    }
+    if(!engine_busy) {
+        eeprom_start_next();
+    }
+    irq_set_enabled(eeprom_irq, true);
+}
+
+// Blocking variants for the driver's own use wait for a free slot
+static EepromRequest *eeprom_queue_blocking(EepromOp op, uint16_t address, uint16_t len, uint8_t *buffer)
+{
+    EepromRequest *req;
+    while((req = eeprom_queue(op, address, len, buffer, NULL, NULL)) == NULL) {
+        tight_loop_contents();
+    }
+    return req;
+}
+
+static bool eeprom_wait_request(EepromRequest *req)
+{
+    while(req->status == EEPROM_QUEUED || req->status == EEPROM_ACTIVE) {
+        tight_loop_contents();
+    }
+    return req->status == EEPROM_DONE;
+}
+
+// Blocking read at `baud_rate`, used only before the IRQ driven engine starts
+static bool eeprom_probe(uint baud_rate, uint8_t *buffer)
+{
+    uint8_t addr[] = { 0, 0 };
+
+    i2c_set_baudrate(eeprom_i2c, baud_rate);
+    return i2c_write_timeout_us(eeprom_i2c, DEV_ADDR, addr, 2, true, 10000) == 2 &&
+           i2c_read_timeout_us(eeprom_i2c, DEV_ADDR, buffer, PROBE_LEN, false, 10000) == PROBE_LEN;
+}
+
+void eeprom_init(i2c_inst_t *i2c, uint baud_rate, uint sda_pin, uint scl_pin)
+{
+    eeprom_i2c = i2c;
+    i2c_init(i2c, EEPROM_BAUD_STANDARD);
+    gpio_set_function(sda_pin, GPIO_FUNC_I2C);
+    gpio_set_function(scl_pin, GPIO_FUNC_I2C);
+
+    // Fast-mode depends on the bus pull-ups, so only keep it if the part
+    // reads back the same bytes at both rates
+    stats.baud_rate = EEPROM_BAUD_STANDARD;
+    if(baud_rate > EEPROM_BAUD_STANDARD) {
+        uint8_t slow[PROBE_LEN];
+        uint8_t fast[PROBE_LEN];
+        if(eeprom_probe(EEPROM_BAUD_STANDARD, slow) && eeprom_probe(baud_rate, fast) &&
+           memcmp(slow, fast, PROBE_LEN) == 0) {
+            stats.baud_rate = baud_rate;
+        }
+    }
+    stats.baud_rate = i2c_set_baudrate(i2c, stats.baud_rate);
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->enable = 0;
+    hw->tar = DEV_ADDR;
+    hw->enable = 1;
+
+    tx_chan = dma_claim_unused_channel(true);
+    tx_config = dma_channel_get_default_config(tx_chan);
+    channel_config_set_transfer_data_size(&tx_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&tx_config, true);
+    channel_config_set_write_increment(&tx_config, false);
+    channel_config_set_dreq(&tx_config, i2c_get_dreq(i2c, true));
+
+    rx_chan = dma_claim_unused_channel(true);
+    rx_config = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&rx_config, DMA_SIZE_8);
+    channel_config_set_read_increment(&rx_config, false);
+    channel_config_set_write_increment(&rx_config, true);
+    channel_config_set_dreq(&rx_config, i2c_get_dreq(i2c, false));
+
+    hw->dma_cr = I2C_IC_DMA_CR_TDMAE_BITS | I2C_IC_DMA_CR_RDMAE_BITS;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS;
+
+    eeprom_irq = i2c == i2c0 ? I2C0_IRQ : I2C1_IRQ;
+    irq_set_exclusive_handler(eeprom_irq, eeprom_i2c_irq);
+    irq_set_enabled(eeprom_irq, true);
+
+    stats_since_us = time_us_64();
+}
+
+void eeprom_set_async(bool async)
+{
+    eeprom_wait_ready();
+    async_writes = async;
+}
+
+bool eeprom_wait_ready(void)
+{
+    while(q_active != q_submit) {
+        tight_loop_contents();
+    }
+    if(!write_pending) {
+        return true;
+    }
+
+    // A one byte read is ACK polled like any other request and leaves the
+    // memory untouched
+    static uint8_t dummy;
+    EepromRequest *req = eeprom_queue_blocking(EEPROM_OP_READ_CURRENT, 0, 1, &dummy);
+    eeprom_commit();
+    return eeprom_wait_request(req);
+}
+
+bool eeprom_write_async(uint16_t address, const uint8_t *data, size_t len, EepromCallback callback, void *ctx)
+{
+    if(len == 0 || address % PAGE_SIZE + len > PAGE_SIZE) {
+        return false;
+    }
+
+    EepromRequest *req = eeprom_queue(EEPROM_OP_WRITE, address, len, NULL, callback, ctx);
+    if(req == NULL) {
+        return false;
+    }
+    memcpy(req->data, data, len);
+    eeprom_commit();
+
+    // A cached copy of the page takes the new bytes as written already, so
+    // neither a read nor a later flush brings back the old ones
+    size_t offset = address % PAGE_SIZE;
+    CacheLine *line = cache_find(address - offset);
+    if(line != NULL) {
+        memcpy(&line->data[offset], data, len);
+        line->valid |= byte_mask(offset, len);
+        line->dirty &= ~byte_mask(offset, len);
+    }
+    return true;
+}
+
+bool eeprom_read_async(uint16_t address, uint8_t *buffer, size_t len, EepromCallback callback, void *ctx)
+{
+    if(len == 0 || len > EEPROM_SCAN_CHUNK) {
+        return false;
+    }
+
+    EepromRequest *req = eeprom_queue(EEPROM_OP_READ, address, len, buffer, callback, ctx);
+    if(req == NULL) {
+        return false;
+    }
+    req->overlay = true;
+    eeprom_commit();
+    return true;
+}
+
+// Writes within a single page. Returns once queued; the queue keeps the order.
+static void eeprom_write_page(uint16_t address, const uint8_t *data, size_t len)
+{
+    EepromRequest *req = eeprom_queue_blocking(EEPROM_OP_WRITE, address, len, NULL);
+    memcpy(req->data, data, len);
+    eeprom_commit();
+
+    if(!async_writes) {
+        eeprom_wait_request(req);
+        eeprom_wait_ready();
+    }
+}
+
+// Every chunk sets its own address: a callback run while waiting for queue
+// room can slip a write in between and move the part's address counter
+static void eeprom_read_raw(uint16_t address, uint8_t *buffer, size_t len)
+{
+    while(len > 0) {
+        uint16_t n = len < EEPROM_SCAN_CHUNK ? len : EEPROM_SCAN_CHUNK;
+        EepromRequest *req = eeprom_queue_blocking(EEPROM_OP_READ, address, n, buffer);
+        eeprom_commit();
+        eeprom_wait_request(req);
+
+        address += n;
+        buffer += n;
+        len -= n;
+    }
+}
+
+static void cache_flush_line(CacheLine *line);
+
+// Takes the page as read from the part wherever the line has nothing newer,
+// then queues the write the fill was waiting for
+static void cache_fill_done(bool ok, void *ctx)
+{
+    CacheLine *line = ctx;
+
+    line->filling = false;
+    if(!ok) {
+        return; // still dirty, so eeprom_poll() tries again
+    }
+    for(uint8_t i = 0; i < PAGE_SIZE; i++) {
+        if(!(line->valid & (1ULL << i))) {
+            line->data[i] = line->fill[i];
+        }
+    }
+    line->valid = ~0ULL;
+    cache_flush_line(line);
+}
+
+static void cache_flush_line(CacheLine *line)
+{
+    if(line->dirty == 0 || line->filling) {
+        return;
+    }
+
+    uint8_t lo = __builtin_ctzll(line->dirty);
+    uint8_t hi = 63 - __builtin_clzll(line->dirty);
+    uint64_t span = byte_mask(lo, hi - lo + 1);
+
+    // One write covers every dirty byte, so gaps between them have to be
+    // filled from the part first. The read is queued like the write;
+    // cache_fill_done() queues the write once it has come back.
+    if((line->valid & span) != span) {
+        EepromRequest *req;
+        while((req = eeprom_queue(EEPROM_OP_READ, line->page, PAGE_SIZE, line->fill, cache_fill_done, line)) == NULL) {
+            tight_loop_contents();
+        }
+        line->filling = true;
+        eeprom_commit();
+        return;
+    }
+
+    eeprom_write_page(line->page + lo, &line->data[lo], hi - lo + 1);
+    line->dirty = 0;
+    stats.cache_flushes++;
+}
+
+static void cache_wait_fill(CacheLine *line)
+{
+    while(line->filling) {
+        eeprom_retire();
+        tight_loop_contents();
+    }
+}
+
+static CacheLine *cache_allocate(uint16_t page)
+{
+    CacheLine *line = cache_find(page);
+    if(line != NULL) {
+        return line;
+    }
+
+    // Take a free line, or evict the least recently used one. A line whose
+    // gap fill is outstanding stays put until the fill is back.
+    line = NULL;
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        if(cache[i].filling) {
+            continue;
+        }
+        if(cache[i].valid == 0) {
+            line = &cache[i];
+            break;
+        }
+        if(line == NULL || cache[i].last_use_us - line->last_use_us > INT32_MAX) {
+            line = &cache[i];
+        }
+    }
+    if(line == NULL) {
+        line = &cache[0];
+        cache_wait_fill(line);
+    }
+
+    // Only a page with gaps makes eviction wait, and only for its fill read
+    cache_flush_line(line);
+    cache_wait_fill(line);
+
+    line->page = page;
+    line->valid = 0;
+    return line;
+}
+
+void eeprom_write_byte(uint16_t address, uint8_t byte)
+{
+    eeprom_write_multi_byte(address, &byte, 1);
+}
+
+uint8_t eeprom_read_byte(uint16_t address)
+{
+    uint8_t buf;
+    eeprom_read_multi_byte(address, &buf, 1);
+    return buf;
+}
+
+void eeprom_write_multi_byte(uint16_t address, const uint8_t *data, size_t len)
+{
+    uint32_t now = time_us_32();
+
+    // Split at page boundaries; a write running past the end of a page would
+    // wrap around to the start of the same page.
+    while(len > 0) {
+        size_t offset = address % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - offset;
+        if(chunk > len) {
+            chunk = len;
+        }
+
+        CacheLine *line = cache_allocate(address - offset);
+        if(line->dirty == 0) {
+            line->dirty_since_us = now;
+        }
+        memcpy(&line->data[offset], data, chunk);
+        line->valid |= byte_mask(offset, chunk);
+        line->dirty |= byte_mask(offset, chunk);
+        line->last_write_us = now;
+        line->last_use_us = now;
+        stats.cache_writes++;
+
+        address += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void eeprom_read_multi_byte(uint16_t address, uint8_t *buffer, size_t len)
+{
+    uint16_t end = address + len;
+    bool hit = true;
+
+    for(uint16_t page = address - address % PAGE_SIZE; page < end && hit; page += PAGE_SIZE) {
+        uint16_t from = address > page ? address : page;
+        uint16_t to = end < page + PAGE_SIZE ? end : page + PAGE_SIZE;
+        uint64_t mask = byte_mask(from - page, to - from);
+        CacheLine *line = cache_find(page);
+        hit = line != NULL && (line->valid & mask) == mask;
+    }
+
+    if(hit) {
+        stats.cache_hits++;
+    } else {
+        stats.cache_misses++;
+        eeprom_read_raw(address, buffer, len);
+    }
+    cache_overlay(address, buffer, len);
+}
+
+void eeprom_flush(void)
+{
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        cache_flush_line(&cache[i]);
+    }
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        cache_wait_fill(&cache[i]);
+    }
+}
+
+void eeprom_poll(void)
+{
+    uint32_t now = time_us_32();
+
+    eeprom_retire();
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        CacheLine *line = &cache[i];
+        if(line->dirty != 0 && (now - line->last_write_us >= EEPROM_CACHE_IDLE_US ||
+                                now - line->dirty_since_us >= EEPROM_CACHE_MAX_AGE_US)) {
+            cache_flush_line(line);
+        }
+    }
+}
+
+void eeprom_scan(uint16_t address, size_t len, EepromScanCallback callback, void *ctx)
+{
+    static uint8_t chunk[EEPROM_SCAN_CHUNK];
+
+    // Each chunk is addressed again, as in eeprom_read_raw(), at 2 bytes per
+    // EEPROM_SCAN_CHUNK
+    while(len > 0) {
+        size_t n = len < EEPROM_SCAN_CHUNK ? len : EEPROM_SCAN_CHUNK;
+        EepromRequest *req = eeprom_queue_blocking(EEPROM_OP_READ, address, n, chunk);
+        eeprom_commit();
+        eeprom_wait_request(req);
+
+        cache_overlay(address, chunk, n);
+        if(!callback(address, chunk, n, ctx)) {
+            return;
+        }
+        address += n;
+        len -= n;
+    }
+}
+
+void eeprom_get_stats(EepromStats *out)
+{
+    // The IRQ updates the 64-bit counters in two halves
+    irq_set_enabled(eeprom_irq, false);
+    *out = stats;
+    irq_set_enabled(eeprom_irq, true);
+
+    out->queue_depth = q_submit - q_retire;
+    out->elapsed_us = time_us_64() - stats_since_us;
+    out->cache_dirty = 0;
+    for(uint8_t i = 0; i < EEPROM_CACHE_LINES; i++) {
+        if(cache[i].dirty != 0) {
+            out->cache_dirty++;
+        }
+    }
+}
+
+void eeprom_reset_stats(void)
+{
+    uint32_t baud_rate = stats.baud_rate;
+
+    irq_set_enabled(eeprom_irq, false);
+    memset(&stats, 0, sizeof(stats));
+    stats.baud_rate = baud_rate;
+    stats.busy_min_us = UINT32_MAX;
+    stats.latency_min_us = UINT32_MAX;
+    stats_since_us = time_us_64();
+    irq_set_enabled(eeprom_irq, true);
+}
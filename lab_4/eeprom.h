@@ -0,0 +1,104 @@
+#ifndef EEPROM_H
+#define EEPROM_H
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+#define DEV_ADDR 0x50
+#define HIGHEST_ADDR (0x7FFF)
+#define PAGE_SIZE 64
+#define MAGIC_BYTE 0xA5 // erased value
+
+#define EEPROM_WRITE_TIMEOUT_US 10000 // datasheet tWC is 5 ms max
+#define EEPROM_SCAN_CHUNK 256
+#define EEPROM_BAUD_STANDARD 100000
+#define EEPROM_QUEUE_LEN 8 // must divide 256
+
+// Dirty pages are written back once they have not been written for
+// EEPROM_CACHE_IDLE_US, or have been dirty for EEPROM_CACHE_MAX_AGE_US, which
+// bounds what a power loss can take with it.
+#define EEPROM_CACHE_LINES 4
+#define EEPROM_CACHE_IDLE_US 250000
+#define EEPROM_CACHE_MAX_AGE_US 2000000
+
+// Receives consecutive chunks of a scan. `data` is reused for the next chunk.
+// Return false to stop the scan early. Must not access the EEPROM itself.
+typedef bool (*EepromScanCallback)(uint16_t address, const uint8_t *data, size_t len, void *ctx);
+
+// Runs from eeprom_poll() once a queued request has completed. `ok` is false
+// if the part never acknowledged it.
+typedef void (*EepromCallback)(bool ok, void *ctx);
+
+typedef struct EepromStats {
+    uint32_t writes;
+    uint32_t bytes_written; // bytes sent in write transactions, i.e. cells worn
+    uint32_t timeouts;      // writes not acknowledged within EEPROM_WRITE_TIMEOUT_US
+    uint32_t measured;      // writes whose end of cycle was observed by polling
+    uint32_t busy_min_us;
+    uint32_t busy_max_us;
+    uint64_t busy_total_us; // over measured writes
+    uint32_t stalls;        // async only: operations that found the part still busy
+    uint64_t stall_total_us;
+    uint32_t cache_hits;    // reads served entirely from the cache
+    uint32_t cache_misses;
+    uint32_t cache_writes;  // page chunks written by callers
+    uint32_t cache_flushes; // page writes actually sent to the part
+    uint8_t cache_dirty;    // pages still waiting to be written back
+    uint32_t baud_rate;     // rate the bus actually runs at after the init probe
+    uint8_t queue_depth;    // requests queued or waiting to be retired
+    uint8_t queue_peak;
+    uint32_t requests;
+    uint32_t latency_min_us; // from queueing to completion
+    uint32_t latency_max_us;
+    uint64_t latency_total_us;
+    uint64_t bus_busy_us;   // time with a transfer on the bus, polling included
+    uint64_t elapsed_us;    // since the last reset, for bus utilization
+} EepromStats;
+
+// Transfers run from a request queue serviced by the I2C interrupt and DMA.
+// Rates above EEPROM_BAUD_STANDARD are probed against a read at 100 kHz and
+// dropped back to it if the bus does not cope.
+void eeprom_init(i2c_inst_t *i2c, uint baud_rate, uint sda_pin, uint scl_pin);
+
+// In async mode a page write returns as soon as it is queued and the bus
+// ACK polls the part before the next request. Otherwise each write waits for
+// its write cycle to finish before returning.
+void eeprom_set_async(bool async);
+
+// Waits for the queue to drain and the part to ACK again after a write.
+// Returns false if the write cycle did not finish within EEPROM_WRITE_TIMEOUT_US.
+bool eeprom_wait_ready(void);
+
+// Writes go to the cache and reach the part from eeprom_poll(), eeprom_flush()
+// or when their page is evicted. Reads and scans always see cached data.
+void eeprom_write_byte(uint16_t address, uint8_t byte);
+uint8_t eeprom_read_byte(uint16_t address);
+// Any address and length, split at page boundaries
+void eeprom_write_multi_byte(uint16_t address, const uint8_t *data, size_t len);
+void eeprom_read_multi_byte(uint16_t address, uint8_t *buffer, size_t len);
+
+// Queue a transfer and return at once, bypassing the cache. A write must stay
+// within one page and its data is copied; a cached copy of the page is
+// updated to match. A read is at most EEPROM_SCAN_CHUNK bytes, gets any newer
+// cached data laid over it, and `buffer` must stay valid until `callback`.
+// Both return false if the queue is full or the request is out of range.
+bool eeprom_write_async(uint16_t address, const uint8_t *data, size_t len, EepromCallback callback, void *ctx);
+bool eeprom_read_async(uint16_t address, uint8_t *buffer, size_t len, EepromCallback callback, void *ctx);
+
+// Reads `len` bytes from `address` with the part's sequential read, a chunk
+// of up to EEPROM_SCAN_CHUNK bytes per transaction, handing each to `callback`.
+// Chunks start at address + n * EEPROM_SCAN_CHUNK.
+void eeprom_scan(uint16_t address, size_t len, EepromScanCallback callback, void *ctx);
+
+// Queues a write for every dirty page, e.g. before power-down. Pages with
+// gaps between their dirty bytes have them read in first.
+void eeprom_flush(void);
+
+// Runs callbacks of completed requests and queues the pages due under the
+// flush policy. Call from the main loop.
+void eeprom_poll(void);
+
+void eeprom_get_stats(EepromStats *stats);
+void eeprom_reset_stats(void);
+
+#endif
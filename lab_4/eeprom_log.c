@@ -0,0 +1,302 @@
+#include <string.h>
+#include "eeprom_log.h"
+#include "eeprom.h"
+#include "crc16.h"
+
+#define SEQ_ERASED ((uint32_t) MAGIC_BYTE * 0x01010101)
+
+// Cached at boot; records are appended to block `head` at `head_offset`
+static uint8_t epoch;
+static int8_t head = -1;
+static uint8_t head_offset;
+static uint8_t count;
+static uint32_t head_time;
+static uint16_t head_crc; // over the head block's header, carried on into its records
+static uint32_t next_seq = 1;
+
+static bool scrub_enabled;
+static uint8_t scrub_next = LOG_BLOCK_COUNT;
+static uint32_t scrub_last_us;
+
+typedef struct LogScan {
+    LogCallback callback;
+    void *ctx;
+} LogScan;
+
+static uint32_t seq_decode(const uint8_t *data)
+{
+    return (uint32_t) data[0] << 24 | (uint32_t) data[1] << 16 | (uint32_t) data[2] << 8 | data[3];
+}
+
+static uint32_t block_header(uint8_t block, uint8_t *block_epoch)
+{
+    uint8_t data[LOG_HEADER_SIZE];
+    eeprom_read_multi_byte(LOG_BASE_ADDR + block * LOG_BLOCK_SIZE, data, LOG_HEADER_SIZE);
+    *block_epoch = data[0];
+    return seq_decode(&data[1]);
+}
+
+// SEQ_ERASED unless the block was written in the current epoch
+static uint32_t block_seq(uint8_t block)
+{
+    uint8_t block_epoch;
+    uint32_t seq = block_header(block, &block_epoch);
+    return block_epoch == epoch ? seq : SEQ_ERASED;
+}
+
+static uint8_t record_encode(const LogRecord *record, uint32_t time, uint16_t header_crc, uint8_t *out)
+{
+    uint8_t len = 0;
+
+    out[len++] = (record->type & 0x07) << 4 | (record->led & 0x07) << 1 | (record->state & 0x01);
+    do {
+        out[len++] = (time & 0x7F) | (time > 0x7F ? 0x80 : 0);
+        time >>= 7;
+    } while(time != 0);
+
+    uint16_t crc = crc16_update(header_crc, out, len);
+    out[len++] = crc >> 8;
+    out[len++] = crc;
+    return len;
+}
+
+// Decodes the record at block[offset]. Returns its length, or 0 at the end of
+// the block's records or on a bad CRC, with `*valid` telling the two apart.
+static uint8_t record_decode(const uint8_t *block, uint8_t offset, uint32_t *time, LogRecord *record, bool *valid)
+{
+    const uint8_t *p = &block[offset];
+    uint8_t avail = LOG_BLOCK_SIZE - offset;
+    uint8_t len = 1;
+    uint32_t value = 0;
+
+    *valid = true;
+    if(avail < 4 || p[0] == MAGIC_BYTE) {
+        return 0;
+    }
+
+    for(uint8_t shift = 0; len < avail && shift < 35; shift += 7) {
+        value |= (uint32_t) (p[len] & 0x7F) << shift;
+        if(!(p[len++] & 0x80)) {
+            break;
+        }
+    }
+    // One pass over the header, the fields and the stored CRC leaves zero.
+    // Records left over from the block's previous use fail under its new header.
+    if(len + 2 > avail || (p[len - 1] & 0x80) ||
+       crc16_update(crc16_update(crc16(block, LOG_HEADER_SIZE), p, len), &p[len], 2) != 0) {
+        *valid = false;
+        return 0;
+    }
+
+    record->type = (p[0] >> 4) & 0x07;
+    record->led = (p[0] >> 1) & 0x07;
+    record->state = p[0] & 0x01;
+    if(offset == LOG_HEADER_SIZE || record->type == LOG_EVENT_BOOT) {
+        *time = value;
+    } else {
+        *time += value;
+    }
+    record->time_s = *time;
+    return len + 2;
+}
+
+// Makes `block` the head, with new records going after the last one that
+// decodes. False if it has none: every block is taken over with a record in
+// the same write, so it was torn by a power loss.
+static bool head_load(uint8_t block)
+{
+    uint8_t data[LOG_BLOCK_SIZE];
+    LogRecord record;
+    bool valid;
+    uint8_t len;
+
+    eeprom_read_multi_byte(LOG_BASE_ADDR + block * LOG_BLOCK_SIZE, data, LOG_BLOCK_SIZE);
+    head = block;
+    head_crc = crc16(data, LOG_HEADER_SIZE);
+    next_seq = seq_decode(&data[1]) + 1;
+    head_offset = LOG_HEADER_SIZE;
+    head_time = 0;
+    while((len = record_decode(data, head_offset, &head_time, &record, &valid)) > 0) {
+        head_offset += len;
+    }
+    return head_offset > LOG_HEADER_SIZE;
+}
+
+void log_init(void)
+{
+    // Until the first erase there is no epoch record. Starting at 1 leaves the
+    // older header format, whose first byte is zero, stale.
+    uint8_t stored[2];
+    eeprom_read_multi_byte(LOG_EPOCH_ADDR, stored, sizeof(stored));
+    epoch = stored[0] == (uint8_t) ~stored[1] ? stored[0] : 1;
+
+    // Blocks written in the current pass over the ring form a prefix with
+    // sequence numbers at or above block 0's; the newest is the last of them.
+    // A torn block's sequence number can be anything, but only the block
+    // being taken over can be torn, so it is the one after the newest.
+    uint32_t first = block_seq(0);
+    if(first != SEQ_ERASED && !head_load(0)) {
+        // Block 0 can't anchor the search; the newest block is the last one
+        first = SEQ_ERASED;
+        if(block_seq(LOG_BLOCK_COUNT - 1) != SEQ_ERASED) {
+            head_load(LOG_BLOCK_COUNT - 1);
+            count = LOG_BLOCK_COUNT;
+            scrub_next = count;
+            return;
+        }
+    }
+    if(first == SEQ_ERASED) {
+        head = -1;
+        count = 0;
+        scrub_next = 0;
+        return;
+    }
+
+    uint8_t lo = 1;
+    uint8_t hi = LOG_BLOCK_COUNT;
+    while(lo < hi) {
+        uint8_t mid = (lo + hi) / 2;
+        uint32_t seq = block_seq(mid);
+        if(seq != SEQ_ERASED && seq >= first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    count = lo == LOG_BLOCK_COUNT || block_seq(lo) == SEQ_ERASED ? lo : LOG_BLOCK_COUNT;
+    if(!head_load(lo - 1)) {
+        // Taken over again by the next append
+        head_load(lo - 2);
+        if(count < LOG_BLOCK_COUNT) {
+            count--;
+        }
+    }
+    scrub_next = count;
+}
+
+void log_append(const LogRecord *record)
+{
+    uint8_t buf[LOG_BLOCK_SIZE];
+    bool fresh = head < 0 || head_offset + LOG_RECORD_MAX > LOG_BLOCK_SIZE;
+    uint32_t time = fresh || record->type == LOG_EVENT_BOOT ? record->time_s : record->time_s - head_time;
+
+    if(!fresh) {
+        uint8_t len = record_encode(record, time, head_crc, buf);
+        eeprom_write_multi_byte(LOG_BASE_ADDR + head * LOG_BLOCK_SIZE + head_offset, buf, len);
+        head_offset += len;
+        head_time = record->time_s;
+        return;
+    }
+
+    // Take over the oldest block with a single page write, clearing whatever
+    // records it held
+    head = (head + 1) % LOG_BLOCK_COUNT;
+    memset(buf, MAGIC_BYTE, LOG_BLOCK_SIZE);
+    buf[0] = epoch;
+    buf[1] = next_seq >> 24;
+    buf[2] = next_seq >> 16;
+    buf[3] = next_seq >> 8;
+    buf[4] = next_seq;
+    head_crc = crc16(buf, LOG_HEADER_SIZE);
+    head_offset = LOG_HEADER_SIZE + record_encode(record, time, head_crc, &buf[LOG_HEADER_SIZE]);
+    head_time = record->time_s;
+    eeprom_write_multi_byte(LOG_BASE_ADDR + head * LOG_BLOCK_SIZE, buf, LOG_BLOCK_SIZE);
+
+    if(count < LOG_BLOCK_COUNT) {
+        count++;
+    }
+    next_seq++;
+}
+
+// Chunks are a whole number of blocks, so a block never spans two
+static bool log_scan_blocks(uint16_t address, const uint8_t *data, size_t len, void *ctx)
+{
+    LogScan *scan = ctx;
+
+    for(size_t block = 0; block < len; block += LOG_BLOCK_SIZE) {
+        if(data[block] != epoch || seq_decode(&data[block + 1]) == SEQ_ERASED) {
+            continue;
+        }
+
+        LogRecord record;
+        uint32_t time = 0;
+        bool valid;
+        uint8_t offset = LOG_HEADER_SIZE;
+        uint8_t n;
+        while((n = record_decode(&data[block], offset, &time, &record, &valid)) > 0) {
+            scan->callback(&record, scan->ctx);
+            offset += n;
+        }
+        if(!valid) {
+            scan->callback(NULL, scan->ctx);
+        }
+    }
+    return true;
+}
+
+void log_for_each(LogCallback callback, void *ctx)
+{
+    LogScan scan = { callback, ctx };
+    uint8_t oldest = count < LOG_BLOCK_COUNT ? 0 : (head + 1) % LOG_BLOCK_COUNT;
+
+    eeprom_scan(LOG_BASE_ADDR + oldest * LOG_BLOCK_SIZE, (LOG_BLOCK_COUNT - oldest) * LOG_BLOCK_SIZE,
+                log_scan_blocks, &scan);
+    if(oldest > 0) {
+        eeprom_scan(LOG_BASE_ADDR, oldest * LOG_BLOCK_SIZE, log_scan_blocks, &scan);
+    }
+}
+
+void log_erase(void)
+{
+    // Skip every epoch still found in a block header, so no old block can
+    // ever turn current again. There are fewer blocks than epochs.
+    uint32_t used[256 / 32] = { 0 };
+    for(uint8_t block = 0; block < LOG_BLOCK_COUNT; block++) {
+        uint8_t block_epoch;
+        if(block_header(block, &block_epoch) != SEQ_ERASED) {
+            used[block_epoch / 32] |= 1u << block_epoch % 32;
+        }
+    }
+    do {
+        epoch++;
+    } while(used[epoch / 32] & (1u << epoch % 32));
+
+    uint8_t stored[2] = { epoch, ~epoch };
+    eeprom_write_multi_byte(LOG_EPOCH_ADDR, stored, sizeof(stored));
+    eeprom_flush();
+
+    head = -1;
+    count = 0;
+    scrub_next = 0;
+}
+
+void log_set_scrub(bool enabled)
+{
+    scrub_enabled = enabled;
+}
+
+void log_poll(void)
+{
+    uint32_t now = time_us_32();
+
+    if(!scrub_enabled || now - scrub_last_us < LOG_SCRUB_INTERVAL_US) {
+        return;
+    }
+    // Blocks below `count` are in use again
+    if(scrub_next < count) {
+        scrub_next = count;
+    }
+    if(scrub_next >= LOG_BLOCK_COUNT) {
+        return;
+    }
+    scrub_last_us = now;
+
+    uint8_t block_epoch;
+    if(block_header(scrub_next, &block_epoch) != SEQ_ERASED && block_epoch != epoch) {
+        uint8_t buffer[LOG_BLOCK_SIZE];
+        memset(buffer, MAGIC_BYTE, LOG_BLOCK_SIZE);
+        eeprom_write_multi_byte(LOG_BASE_ADDR + scrub_next * LOG_BLOCK_SIZE, buffer, LOG_BLOCK_SIZE);
+    }
+    scrub_next++;
+}
@@ -0,0 +1,60 @@
+#ifndef EEPROM_LOG_H
+#define EEPROM_LOG_H
+
+#include "pico/stdlib.h"
+
+// Circular log at the bottom of the EEPROM, one block per page. A block
+// starts with an epoch byte and a 32-bit big-endian sequence number followed
+// by packed records:
+//   byte 0    0 | type:3 | led:3 | state:1
+//   varint    seconds since boot; a delta from the previous record except
+//             for the first record of a block and for LOG_EVENT_BOOT
+//   2 bytes   CRC16 over the block header and the two fields above
+// Blocks from any epoch other than the one stored at LOG_EPOCH_ADDR count as
+// erased, so erasing the log is a single small write.
+#define LOG_BASE_ADDR 0x0000
+#define LOG_SIZE 0x800
+#define LOG_BLOCK_SIZE 64
+#define LOG_BLOCK_COUNT (LOG_SIZE / LOG_BLOCK_SIZE)
+#define LOG_HEADER_SIZE 5
+#define LOG_RECORD_MAX 8
+#define LOG_EPOCH_ADDR (LOG_BASE_ADDR + LOG_SIZE) // epoch and its complement
+
+// Stale blocks are rewritten with MAGIC_BYTE one at a time, at most this often
+#define LOG_SCRUB_INTERVAL_US 100000
+
+typedef enum LogEvent {
+    LOG_EVENT_BOOT,
+    LOG_EVENT_LED
+} LogEvent;
+
+typedef struct LogRecord {
+    uint8_t type;
+    uint8_t led;
+    uint8_t state;
+    uint32_t time_s;
+} LogRecord;
+
+// `record` is NULL where a record fails its CRC; the rest of that block is skipped
+typedef void (*LogCallback)(const LogRecord *record, void *ctx);
+
+// Finds the newest block by binary search over the sequence numbers, then
+// the end of its records
+void log_init(void);
+
+// Starting a new block overwrites the oldest one
+void log_append(const LogRecord *record);
+
+// Visits the records from oldest to newest
+void log_for_each(LogCallback callback, void *ctx);
+
+// Starts a new epoch, leaving the old blocks in place to be overwritten or scrubbed
+void log_erase(void);
+
+// Enables physically clearing blocks left over from earlier epochs from log_poll()
+void log_set_scrub(bool enabled);
+
+// Call from the main loop
+void log_poll(void);
+
+#endif
@@ -0,0 +1,119 @@
+#include <stddef.h>
+#include <string.h>
+#include "led_state.h"
+#include "crc16.h"
+
+_Static_assert(sizeof(LedSlot) <= LED_SLOT_SIZE, "LED slot does not fit");
+
+static uint8_t led_head;
+static uint32_t led_next_seq = 1;
+
+void led_set_state(LED_State *state, uint8_t value)
+{
+    state->state = value;
+    state->not_state = ~value;
+}
+
+bool led_state_is_valid(LED_State *state)
+{
+    return state->state == (uint8_t) ~state->not_state;
+}
+
+uint32_t led_slot_seq(uint8_t slot)
+{
+    uint32_t seq;
+    eeprom_read_multi_byte(LED_RING_ADDR + slot * LED_SLOT_SIZE, (uint8_t *) &seq, sizeof(seq));
+    return seq;
+}
+
+static uint16_t led_slot_crc(const LedSlot *slot)
+{
+    return crc16((const uint8_t *) slot, offsetof(LedSlot, crc));
+}
+
+// False if the slot fails its CRC
+static bool led_slot_read(uint8_t slot, LedSlot *stored)
+{
+    eeprom_read_multi_byte(LED_RING_ADDR + slot * LED_SLOT_SIZE, (uint8_t *) stored, sizeof(*stored));
+    return stored->crc == led_slot_crc(stored);
+}
+
+void eeprom_store_led_state_from_struct(LED_State *leds)
+{
+    LedSlot slot;
+    memset(&slot, 0xFF, sizeof(slot));
+    slot.seq = led_next_seq++;
+    memcpy(slot.leds, leds, sizeof(slot.leds));
+    slot.crc = led_slot_crc(&slot);
+
+    eeprom_write_multi_byte(LED_RING_ADDR + led_head * LED_SLOT_SIZE, (uint8_t *) &slot, sizeof(slot));
+    led_head = (led_head + 1) % LED_SLOT_COUNT;
+}
+
+// Binary search: slots written in the current pass over the ring are a
+// prefix with sequence numbers at or above slot 0's. Only the last store can
+// have been torn, and its sequence number can then be anything, so a slot
+// that fails its CRC at the head is taken back and written again.
+bool eeprom_leds_are_initialized(void)
+{
+    LedSlot stored;
+    bool intact = led_slot_read(0, &stored);
+    uint32_t first = stored.seq;
+
+    if(first == LED_SEQ_ERASED) {
+        led_head = 0;
+        return false;
+    }
+    // Slot 0 can't anchor the search then; the newest store is at the end of the ring
+    if(!intact) {
+        uint32_t seq = led_slot_seq(LED_SLOT_COUNT - 1);
+        led_head = 0;
+        led_next_seq = seq == LED_SEQ_ERASED ? 1 : seq + 1;
+        return seq != LED_SEQ_ERASED;
+    }
+
+    uint8_t lo = 1;
+    uint8_t hi = LED_SLOT_COUNT;
+    while(lo < hi) {
+        uint8_t mid = (lo + hi) / 2;
+        uint32_t seq = led_slot_seq(mid);
+        if(seq != LED_SEQ_ERASED && seq >= first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+
+    if(lo > 1) {
+        intact = led_slot_read(lo - 1, &stored);
+    }
+    if(intact) {
+        led_head = lo % LED_SLOT_COUNT;
+        led_next_seq = stored.seq + 1;
+    } else {
+        led_head = lo - 1;
+        led_next_seq = led_slot_seq(lo - 2) + 1;
+    }
+    return true;
+}
+
+void led_read_state_to_struct(LED_State *leds)
+{
+    uint8_t slot = led_head;
+
+    for(uint8_t tries = 0; tries < LED_SLOT_COUNT; tries++) {
+        slot = (slot + LED_SLOT_COUNT - 1) % LED_SLOT_COUNT;
+
+        LedSlot stored;
+        bool intact = led_slot_read(slot, &stored);
+        if(stored.seq == LED_SEQ_ERASED) {
+            return;
+        }
+        if(intact) {
+            for(uint8_t i = 0; i < 3; i++) {
+                led_set_state(&leds[i], stored.leds[i].state);
+            }
+            return;
+        }
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef LED_STATE_H
+#define LED_STATE_H
+
+#include "pico/stdlib.h"
+#include "eeprom.h"
+
+#define LED_ON 0x01
+#define LED_OFF 0x00
+
+// LED states rotate through a ring of slots at the top of the EEPROM so that
+// no single page takes every write. 16 byte slots never straddle a page.
+#define LED_SLOT_SIZE 16
+#define LED_SLOT_COUNT 64
+#define LED_RING_ADDR (HIGHEST_ADDR + 1 - LED_SLOT_SIZE * LED_SLOT_COUNT)
+#define LED_SEQ_ERASED ((uint32_t) MAGIC_BYTE * 0x01010101)
+
+typedef struct LED_State {
+    uint8_t pin;
+    uint8_t state;
+    uint8_t not_state;
+} LED_State;
+
+// The CRC covers everything before it, so a slot torn by a power loss is
+// never taken for a store
+typedef struct LedSlot {
+    uint32_t seq;
+    LED_State leds[3];
+    uint16_t crc;
+} LedSlot;
+
+void led_set_state(LED_State *state, uint8_t value);
+bool led_state_is_valid(LED_State *state);
+
+// LED_SEQ_ERASED if the slot has never been written
+uint32_t led_slot_seq(uint8_t slot);
+
+// Writes the three states to the next slot of the ring
+void eeprom_store_led_state_from_struct(LED_State *leds);
+
+// Finds the next slot to write, which is a torn one if the last store was cut
+// short. Returns false if the ring has never been written.
+bool eeprom_leds_are_initialized(void);
+
+// Takes the newest slot that checks out, so a write torn by a power loss
+// falls back to the state before it. Leaves `leds` as it was if
+// there is none.
+void led_read_state_to_struct(LED_State *leds);
+
+#endif
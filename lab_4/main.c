@@ -4,6 +4,11 @@
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
 #include "hardware/uart.h"
+#include "hardware/clocks.h"
+#include "eeprom.h"
+#include "eeprom_log.h"
+#include "led_state.h"
+#include "crc16.h"
 
 #define I2C1_SDA_PIN 14
 #define I2C1_SCL_PIN 15
@@ -11,14 +16,9 @@
 
 #define UART_ID uart0
 
-#define DEV_ADDR 0x50
-#define HIGHEST_ADDR (0x7FFF)
-#define HIGHEST_STR_ADDR (0x800)
-#define PAGE_SIZE 64
-
-#define MAGIC_BYTE 0xA5
-#define LED_ON 0x01
-#define LED_OFF 0x00
+// Unused space between the log and the LED states, deliberately not page aligned
+#define BENCH_ADDR (0x1000 + PAGE_SIZE / 2)
+#define BENCH_LEN 1024
 
 #define SW_0 9
 #define SW_1 8
@@ -28,21 +28,26 @@
 #define LED_1 21
 #define LED_2 22
 
-typedef struct LED_State {
-    uint8_t pin;
-    uint8_t state;
-    uint8_t not_state;
-} LED_State;
+// Cost of persisting LED changes, as seen from the toggle path
+typedef struct PersistStats {
+    uint32_t events;         // LED changes logged
+    uint32_t stores;         // log appends and LED slot writes
+    uint64_t store_total_us;
+    uint32_t store_max_us;
+    uint32_t recovery_us;    // finding the log head and LED state at boot
+} PersistStats;
 
-void led_set_state(LED_State *state, uint8_t value)
-{
-    state->state = value;
-    state->not_state = ~value;
-}
+static PersistStats persist;
 
-bool led_state_is_valid(LED_State *state)
+static void persist_time_store(uint32_t start)
 {
-    return state->state == (uint8_t) ~state->not_state;
+    uint32_t elapsed = time_us_32() - start;
+
+    persist.stores++;
+    persist.store_total_us += elapsed;
+    if(elapsed > persist.store_max_us) {
+        persist.store_max_us = elapsed;
+    }
 }
 
 void init_gpio(void)
@@ -69,80 +74,85 @@ void init_gpio(void)
     gpio_pull_up(SW_2);
 }
 
-void eeprom_write_byte(uint16_t address, uint8_t byte)
-{
-    uint8_t first = (address >> 8) & 0xFF;
-    uint8_t second = address & 0xFF;
-
-    uint8_t frame[] = { first, second, byte };
-    i2c_write_blocking(I2C_ID, DEV_ADDR, frame, 3, false);
-    sleep_ms(5);
-}
-
-uint8_t eeprom_read_byte(uint16_t address)
+void eeprom_print_stats(void)
 {
-    uint8_t first = (address >> 8) & 0xFF;
-    uint8_t second = address & 0xFF;
-
-    uint8_t addr[] = { first, second };
-
-    i2c_write_blocking(I2C_ID, DEV_ADDR, addr, 2, true);
-    uint8_t buf;
-    i2c_read_blocking(I2C_ID, DEV_ADDR, &buf, 1, false);
-    return buf;
+    EepromStats stats;
+    eeprom_get_stats(&stats);
+
+    uint32_t busy_avg = stats.measured ? stats.busy_total_us / stats.measured : 0;
+    printf("EEPROM: %lu writes, %lu timeouts, write cycle min/avg/max %lu/%lu/%lu us over %lu writes\n",
+           stats.writes, stats.timeouts, stats.measured ? stats.busy_min_us : 0, busy_avg,
+           stats.busy_max_us, stats.measured);
+    printf("EEPROM: %lu operations waited %llu us in total for a write to finish\n",
+           stats.stalls, stats.stall_total_us);
+
+    uint32_t latency_avg = stats.requests ? stats.latency_total_us / stats.requests : 0;
+    uint32_t busy_permille = stats.elapsed_us ? stats.bus_busy_us * 1000 / stats.elapsed_us : 0;
+    printf("Bus: %lu Hz, %lu requests, latency min/avg/max %lu/%lu/%lu us\n",
+           stats.baud_rate, stats.requests, stats.requests ? stats.latency_min_us : 0, latency_avg,
+           stats.latency_max_us);
+    printf("Bus: queue %u/%u, peak %u, %lu.%lu%% busy\n",
+           stats.queue_depth, EEPROM_QUEUE_LEN, stats.queue_peak, busy_permille / 10, busy_permille % 10);
+
+    uint32_t reads = stats.cache_hits + stats.cache_misses;
+    printf("Cache: %lu/%lu reads hit, %lu page writes in, %lu out, %u pages dirty\n",
+           stats.cache_hits, reads, stats.cache_writes, stats.cache_flushes, stats.cache_dirty);
+    printf("Cache: %lu write cycles saved\n",
+           stats.cache_writes - stats.cache_flushes - stats.cache_dirty);
 }
 
-void eeprom_write_multi_byte(uint16_t address, uint8_t *data, size_t len)
+// Rewrites the bench area with MAGIC_BYTE, so the contents stay as "erased"
+void eeprom_write_benchmark(void)
 {
-    uint8_t first = (address >> 8) & 0xFF;
-    uint8_t second = address & 0xFF;
-
-    uint8_t frame[len + 2];
-    frame[0] = first;
-    frame[1] = second;
-    memcpy(&frame[2], data, len);
-    i2c_write_blocking(I2C_ID, DEV_ADDR, frame, len + 2, false);
-    sleep_ms(5);
+    static uint8_t buffer[BENCH_LEN];
+    memset(buffer, MAGIC_BYTE, BENCH_LEN);
+
+    eeprom_wait_ready();
+    uint64_t start = time_us_64();
+    eeprom_write_multi_byte(BENCH_ADDR, buffer, BENCH_LEN);
+    eeprom_flush();
+    eeprom_wait_ready();
+    uint32_t elapsed = time_us_64() - start;
+
+    printf("Wrote %d bytes in %lu us: %lu bytes/s\n", BENCH_LEN, elapsed,
+           (uint32_t) ((uint64_t) BENCH_LEN * 1000000 / elapsed));
 }
 
-void eeprom_read_multi_byte(uint16_t address, uint8_t *buffer, size_t len)
+// Times each CRC back end over the same buffer and checks it against the reference
+void crc_benchmark(void)
 {
-    uint8_t first = (address >> 8) & 0xFF;
-    uint8_t second = address & 0xFF;
-
-    uint8_t addr[] = { first, second };
+    static const char *names[] = { "reference", "table", "slice-by-4", "DMA sniffer" };
+    static uint8_t buffer[BENCH_LEN];
+    const uint rounds = 16;
 
-    i2c_write_blocking(I2C_ID, DEV_ADDR, addr, 2, true);
-    i2c_read_blocking(I2C_ID, DEV_ADDR, buffer, len, false);
-}
-
-void eeprom_clear(void)
-{
-    for(uint16_t address = 0; address < HIGHEST_ADDR + 1; address += PAGE_SIZE) {
-        uint8_t buffer[PAGE_SIZE];
-        memset(buffer, MAGIC_BYTE, PAGE_SIZE);
-        eeprom_write_multi_byte(address, buffer, PAGE_SIZE);
-        printf("Cleared address: %02X\n", address);
+    for(uint i = 0; i < BENCH_LEN; i++) {
+        buffer[i] = rand();
     }
-}
+    uint16_t expected = crc16_reference(CRC16_INIT, buffer, BENCH_LEN);
+    uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
 
-void eeprom_store_led_state_from_struct(LED_State *leds)
-{
-    uint16_t highest_address = HIGHEST_ADDR - sizeof(LED_State) * 3 + 1;
+    for(uint backend = CRC16_REFERENCE; backend <= CRC16_DMA; backend++) {
+        crc16_set_backend(backend);
+        uint16_t crc = crc16(buffer, BENCH_LEN); // first call claims the DMA channel
+
+        uint32_t start = time_us_32();
+        for(uint i = 0; i < rounds; i++) {
+            crc = crc16(buffer, BENCH_LEN);
+        }
+        uint32_t cycles = (time_us_32() - start) * mhz;
 
-    if(highest_address != 0) {
-        eeprom_write_multi_byte(highest_address, (uint8_t *)leds, sizeof(LED_State) * 3);
+        printf("%-12s %3lu.%02lu cycles/byte, CRC 0x%04X %s\n", names[backend],
+               cycles / (BENCH_LEN * rounds), cycles * 100 / (BENCH_LEN * rounds) % 100,
+               crc, crc == expected ? "ok" : "MISMATCH");
     }
+    crc16_set_backend(CRC16_TABLE);
 }
 
-bool eeprom_leds_are_initialized(void)
+bool print_non_magic(uint16_t address, const uint8_t *data, size_t len, void *ctx)
 {
-    uint16_t first_address = HIGHEST_ADDR - sizeof(LED_State) * 3 + 1;
-
-    for(uint16_t address = first_address; address <= HIGHEST_ADDR; address++) {
-        uint8_t value = eeprom_read_byte(first_address);
-        if(value == MAGIC_BYTE) {
-            return false;
+    for(size_t i = 0; i < len; i++) {
+        if(data[i] != MAGIC_BYTE) {
+            printf("Address 0x%04X: Value 0x%02X\n", address + i, data[i]);
         }
     }
     return true;
@@ -150,28 +160,10 @@ bool eeprom_leds_are_initialized(void)
 
 void eeprom_check_contents(void)
 {
-    for(uint16_t address = 0; address <= HIGHEST_ADDR; address++) {
-        uint8_t value = eeprom_read_byte(address);
-        if(value != MAGIC_BYTE) {
-            printf("Address 0x%04X: Value 0x%02X\n", address, value);
-        }
-    }
+    eeprom_scan(0, HIGHEST_ADDR + 1, print_non_magic, NULL);
     printf("End of EEPROM.\n");
 }
 
-void led_read_state_to_struct(LED_State *leds)
-{
-    LED_State eeprom_leds[3];
-
-    eeprom_read_multi_byte(HIGHEST_ADDR - sizeof(LED_State) * 3 + 1, (uint8_t *)eeprom_leds, sizeof(LED_State) * 3);
-
-    for(uint8_t i = 0; i < 3; i++) {
-        if(led_state_is_valid(&eeprom_leds[i])) {
-            led_set_state(&leds[i], eeprom_leds[i].state);
-        }
-    }
-}
-
 void led_apply_state(LED_State *leds)
 {
     for(uint8_t i = 0; i < 3; i++) {
@@ -189,125 +181,112 @@ void led_turn_on(LED_State *leds, uint8_t index)
 {
     bool led_current_state = leds[index].state;
 
+    uint32_t start = time_us_32();
+
     if(led_current_state == LED_ON) {
         led_set_state(&leds[index], LED_OFF);
         eeprom_store_led_state_from_struct(leds);
+        persist_time_store(start);
         led_apply_state(leds);
     } else {
         led_set_state(&leds[index], LED_ON);
         eeprom_store_led_state_from_struct(leds);
+        persist_time_store(start);
         led_apply_state(leds);
     }
 }
 
-uint16_t eeprom_find_lowest_free_str_address(void) {
-    for(uint16_t address = 0; address < HIGHEST_STR_ADDR; address += 64) {
-        if(eeprom_read_byte(address) == MAGIC_BYTE) {
-            return address;
-        }
-    }
-    printf("ERROR: EEPROM is full.\n");
-    return HIGHEST_STR_ADDR;
-}
-
-uint16_t crc16(const uint8_t *data_p, size_t length) {
-    uint8_t x;
-    uint16_t crc = 0xFFFF;
-    while(length--) {
-        x = crc >> 8 ^ *data_p++;
-        x ^= x >> 4;
-        crc = (crc << 8) ^ ((uint16_t) (x << 12)) ^ ((uint16_t) (x << 5)) ^ ((uint16_t) x);
-    }
-    return crc;
-}
-
 void eeprom_clear_str_space(void)
 {
     printf("Clearing EEPROM log entries.\n");
-    for(uint16_t address = 0; address < HIGHEST_STR_ADDR + 1; address += PAGE_SIZE) {
-        uint8_t buffer[PAGE_SIZE];
-        memset(buffer, MAGIC_BYTE, PAGE_SIZE);
-        eeprom_write_multi_byte(address, buffer, PAGE_SIZE);
-    }
-    printf("EEPROM clear.\n");
+    uint32_t start = time_us_32();
+    log_erase();
+    printf("EEPROM clear in %lu us.\n", time_us_32() - start);
 }
 
-void eeprom_write_string(char *data)
+// Text is only produced here, when the log is read back
+void print_log_record(const LogRecord *record, void *ctx)
 {
-    size_t len = strlen(data);
-    if(len > 61) {
-        printf("Log entry is too long.\n");
-        return;
-    }
-
-    uint8_t buf[64];
-    uint16_t crc = crc16((uint8_t *)data, len);
-
-    memcpy(buf, data, len + 1);
-    buf[len] = '\0';
-    buf[len + 1] = (crc >> 8);
-    buf[len + 2] = crc;
-
-    uint16_t address = eeprom_find_lowest_free_str_address();
-    if(address + 64 >= HIGHEST_STR_ADDR) {
-        printf("Too many log entries.\n");
-        eeprom_clear_str_space();
-
-        address = eeprom_find_lowest_free_str_address();
+    if(record == NULL) {
+        printf("Invalid CRC checksum.\n");
+    } else if(record->type == LOG_EVENT_BOOT) {
+        printf("Booting... at: %lu seconds.\n", record->time_s);
+    } else {
+        printf("LED_%d status: %s. State changed at: %lu seconds.\n", record->led,
+               record->state ? "on" : "off", record->time_s);
     }
-
-    eeprom_write_multi_byte(address, buf, len + 3);
 }
 
 void led_state_print_and_store(LED_State *leds, uint8_t index)
 {
-    char log_message[64];
-    sprintf(log_message, "LED_%d status: %s. State changed at: %llu seconds.\n", index, leds[index].state == LED_ON ? "on" : "off", time_us_64() / 1000000);
-    printf("%s", log_message);
-    eeprom_write_string(log_message);
+    LogRecord record = {
+        .type = LOG_EVENT_LED,
+        .led = index,
+        .state = leds[index].state == LED_ON,
+        .time_s = to_ms_since_boot(get_absolute_time()) / 1000
+    };
+
+    uint32_t start = time_us_32();
+    log_append(&record);
+    persist_time_store(start);
+    persist.events++;
+
+    print_log_record(&record, NULL);
 }
 
 void eeprom_read_string(void)
 {
     printf("-----READING LOG-----\n");
+    log_for_each(print_log_record, NULL);
+    printf("-----REACHED END OF LOG-----\n");
+}
 
-    for(uint16_t address = 0; address < HIGHEST_STR_ADDR; address += 64) {
-        if(eeprom_read_byte(address) != MAGIC_BYTE) {
-            uint8_t buf[64];
-            eeprom_read_multi_byte(address, buf, 64);
-
-            size_t len = strlen(buf);
-
-            uint16_t crc = crc16(buf, len);
-            buf[len] = (uint8_t) (crc >> 8);
-            buf[len + 1] = (uint8_t) crc;
+void count_log_record(const LogRecord *record, void *ctx)
+{
+    (*(uint32_t *) ctx)++;
+}
 
-            if(crc16(buf, len + 2) == 0) {
-                buf[len] = '\0';
-                printf("%s", buf);
-            } else {
-                printf("Invalid CRC checksum.\n");
-                return;
-            }
-        }
+// Where the time and wear of persisting an LED change go. The scan is timed
+// without printing, which would otherwise dominate it.
+void persist_report(void)
+{
+    EepromStats stats;
+    uint32_t records = 0;
+    uint32_t start = time_us_32();
+    log_for_each(count_log_record, &records);
+    uint32_t scan_us = time_us_32() - start;
+    eeprom_get_stats(&stats);
+
+    uint32_t store_avg = persist.stores ? persist.store_total_us / persist.stores : 0;
+    printf("Persist: %lu events, store avg/max %lu/%lu us, boot recovery %lu us\n",
+           persist.events, store_avg, persist.store_max_us, persist.recovery_us);
+    printf("Persist: full log scan %lu records in %lu us\n", records, scan_us);
+    if(persist.events > 0) {
+        printf("Persist: %lu.%02lu write cycles, %lu bytes written per event\n",
+               stats.writes / persist.events, stats.writes * 100 / persist.events % 100,
+               stats.bytes_written / persist.events);
     }
-    printf("-----REACHED END OF LOG-----\n");
 }
 
 int main(void)
 {
     stdio_init_all();
 
-    const char *boot_msg = "Booting...\n";
-    printf("%s", boot_msg);
+    printf("Booting...\n");
 
     init_gpio();
 
-    i2c_init(i2c1, 100000);
-    gpio_set_function(I2C1_SDA_PIN, GPIO_FUNC_I2C);
-    gpio_set_function(I2C1_SCL_PIN, GPIO_FUNC_I2C);
+    eeprom_init(I2C_ID, 400000, I2C1_SDA_PIN, I2C1_SCL_PIN);
+    // Let the write cycle run while we go back to polling the buttons
+    eeprom_set_async(true);
+
+    uint32_t recovery_start = time_us_32();
+    log_init();
+    // Old blocks left by an erase are cleared in the background
+    log_set_scrub(true);
 
-    eeprom_write_string(boot_msg);
+    LogRecord boot = { .type = LOG_EVENT_BOOT, .time_s = to_ms_since_boot(get_absolute_time()) / 1000 };
+    log_append(&boot);
 
     LED_State leds[3] = {
             {LED_0, LED_OFF, ~LED_OFF},
@@ -322,6 +301,7 @@ int main(void)
         led_read_state_to_struct(leds);
         led_apply_state(leds);
     }
+    persist.recovery_us = time_us_32() - recovery_start;
 
     printf("Program started at %llu seconds.\n", time_us_64() / 1000000);
 
@@ -329,6 +309,8 @@ int main(void)
     uint8_t index = 0;
 
     while(true) {
+        eeprom_poll();
+        log_poll();
 
         while(uart_is_readable(UART_ID)) {
             char input_char = uart_getc(UART_ID);
@@ -338,6 +320,14 @@ int main(void)
                     eeprom_read_string();
                 } else if(strcmp(buf, "erase") == 0) {
                     eeprom_clear_str_space();
+                } else if(strcmp(buf, "stats") == 0) {
+                    eeprom_print_stats();
+                } else if(strcmp(buf, "bench") == 0) {
+                    eeprom_write_benchmark();
+                } else if(strcmp(buf, "crcbench") == 0) {
+                    crc_benchmark();
+                } else if(strcmp(buf, "persist") == 0) {
+                    persist_report();
                 }
                 index = 0;
             } else {
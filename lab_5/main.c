@@ -3,6 +3,7 @@
 #include <stdlib.h>
 #include "pico/stdlib.h"
 #include "hardware/uart.h"
+#include "stepper.h"
 
 #define IN1 2
 #define IN2 3
@@ -13,112 +14,82 @@
 
 #define UART_ID uart0
 
-void init_gpio(void)
-{
-    gpio_init(OPTO_FORK);
-    gpio_set_dir(OPTO_FORK, GPIO_IN);
-    gpio_pull_up(OPTO_FORK);
+#define STEP_RATE 1000 // half-steps/s, used while measuring
+#define CALIB_REVS 3
 
-    gpio_init(IN1);
-    gpio_set_dir(IN1, GPIO_OUT);
+// Profile for run and go to middle
+#define RUN_MAX_RATE 2000 // half-steps/s
+#define RUN_ACCEL 5000    // half-steps/s^2
+#define RUN_JERK 50000    // half-steps/s^3, S-curve only
 
-    gpio_init(IN2);
-    gpio_set_dir(IN2, GPIO_OUT);
+typedef enum MotorState {
+    MOTOR_IDLE,
+    MOTOR_FIND_FORK,
+    MOTOR_CALIB,
+    MOTOR_TO_MIDDLE,
+    MOTOR_RUN
+} MotorState;
 
-    gpio_init(IN3);
-    gpio_set_dir(IN3, GPIO_OUT);
+static MotorState motor_state = MOTOR_IDLE;
+static MotionPlan run_plan;
 
-    gpio_init(IN4);
-    gpio_set_dir(IN4, GPIO_OUT);
+// Starts the next move from wherever the last one left the coils
+bool motor_move(uint32_t steps)
+{
+    StepperStatus status;
+    stepper_get_status(&status);
+    return stepper_move(status.phase, steps, STEP_RATE);
 }
 
-void turn_off(void)
+bool motor_move_planned(uint32_t steps)
 {
-    gpio_put(IN1, 0);
-    gpio_put(IN2, 0);
-    gpio_put(IN3, 0);
-    gpio_put(IN4, 0);
-    sleep_ms(1);
+    StepperStatus status;
+    stepper_get_status(&status);
+    return stepper_move_plan(status.phase, steps, &run_plan);
 }
 
-void go_to_middle(uint8_t (*steps)[4], uint8_t step_count, uint16_t steps_per_rev, uint16_t steps_to_middle)
+void set_profile(bool scurve)
 {
-    uint16_t counter = 0;
-    while(counter <= (steps_per_rev + steps_to_middle)) {
-        for(uint16_t i = 0; i < step_count; i++) {
-            gpio_put(IN1, steps[i][0]);
-            gpio_put(IN2, steps[i][1]);
-            gpio_put(IN3, steps[i][2]);
-            gpio_put(IN4, steps[i][3]);
-            sleep_ms(1);
-            ++counter;
-        }
+    if(scurve) {
+        motion_plan_scurve(&run_plan, RUN_MAX_RATE, RUN_ACCEL, RUN_JERK);
+    } else {
+        motion_plan_trapezoid(&run_plan, RUN_MAX_RATE, RUN_ACCEL);
     }
+    printf("%s profile, %u ramp steps.\n", scurve ? "S-curve" : "Trapezoidal", run_plan.ramp_len);
 }
 
-void go_to_opto_fork(uint8_t (*steps)[4], uint8_t step_count)
+void go_to_middle(uint16_t steps_per_rev, uint16_t steps_to_middle)
 {
-    bool opto_fork_state = gpio_get(OPTO_FORK);
-    bool last_opto_fork_state = opto_fork_state;
-
-    while(true) {
-        opto_fork_state = gpio_get(OPTO_FORK);
-        if(!opto_fork_state && last_opto_fork_state) {
-            break;
-        }
+    stepper_stop_at_fall(0);
+    motor_move_planned(steps_per_rev + steps_to_middle);
+    motor_state = MOTOR_TO_MIDDLE;
+}
 
-        for(uint16_t i = 0; i < step_count; i++) {
-            gpio_put(IN1, steps[i][0]);
-            gpio_put(IN2, steps[i][1]);
-            gpio_put(IN3, steps[i][2]);
-            gpio_put(IN4, steps[i][3]);
-            sleep_ms(1);
-        }
+void go_to_opto_fork(void)
+{
+    stepper_stop_at_fall(1);
+    motor_move(STEPPER_FOREVER);
+    motor_state = MOTOR_FIND_FORK;
+}
 
-        last_opto_fork_state = opto_fork_state;
-    }
-    turn_off();
-    printf("At opto fork.\n");
+// From the fork edge the motor makes CALIB_REVS revolutions, stopping on the
+// same edge; the time spent inside the fork gives the middle of it
+void calib(void)
+{
+    stepper_stop_at_fall(CALIB_REVS);
+    motor_move(STEPPER_FOREVER);
+    motor_state = MOTOR_CALIB;
 }
 
-void calib(uint8_t (*steps)[4], uint8_t step_count, bool *calibrated, uint16_t *steps_per_rev, uint16_t *steps_to_middle)
+void calib_done(bool *calibrated, uint16_t *steps_per_rev, uint16_t *steps_to_middle)
 {
-    go_to_opto_fork(steps, step_count);
-
-    uint32_t steps_outside_opto_fork = 0;
-    uint32_t steps_at_opto_fork = 0;
-
-    uint8_t revs = 0;
-
-    while(revs != 3) {
-        while(!gpio_get(OPTO_FORK)) {
-            for(uint16_t i = 0; i < step_count; i++) {
-                gpio_put(IN1, steps[i][0]);
-                gpio_put(IN2, steps[i][1]);
-                gpio_put(IN3, steps[i][2]);
-                gpio_put(IN4, steps[i][3]);
-                sleep_ms(1);
-                ++steps_at_opto_fork;
-            }
-        }
-        while(gpio_get(OPTO_FORK)) {
-            for(uint16_t i = 0; i < step_count; i++) {
-                gpio_put(IN1, steps[i][0]);
-                gpio_put(IN2, steps[i][1]);
-                gpio_put(IN3, steps[i][2]);
-                gpio_put(IN4, steps[i][3]);
-                sleep_ms(1);
-                ++steps_outside_opto_fork;
-            }
-        }
-        ++revs;
-    }
-    *steps_to_middle = (steps_at_opto_fork / 3) / 2;
-printf("%d\n", *steps_to_middle);
-    *steps_per_rev = (steps_at_opto_fork + steps_outside_opto_fork) / 3;
+    StepperStatus status;
+    stepper_get_status(&status);
+
+    *steps_to_middle = (status.low_steps / CALIB_REVS) / 2;
+    *steps_per_rev = status.steps / CALIB_REVS;
     *calibrated = true;
     printf("Calibrated. Going to middle.\n");
-    turn_off();
 }
 
 void status(bool calibrated, uint16_t steps_per_rev)
@@ -130,26 +101,59 @@ void status(bool calibrated, uint16_t steps_per_rev)
         printf("Motor is not calibrated.\n");
         printf("Number of steps per revolution not available.\n");
     }
+    if(stepper_busy()) {
+        StepperStatus stepper;
+        stepper_get_status(&stepper);
+        printf("Motor is moving, %lu steps taken.\n", stepper.steps);
+    }
 }
 
-void run(uint8_t (*steps)[4], uint8_t step_count, uint16_t steps_per_rev, uint8_t n)
+uint32_t run_steps(uint16_t steps_per_rev, uint8_t n)
 {
-    uint32_t steps_to_run;
     if(n == 0 || n == 8) {
-        steps_to_run = steps_per_rev;
-    } else {
-        steps_to_run = steps_per_rev / 8 * n;
+        return steps_per_rev;
     }
+    return steps_per_rev / 8 * n;
+}
+
+void run(uint16_t steps_per_rev, uint8_t n)
+{
+    stepper_stop_at_fall(0);
+    motor_move_planned(run_steps(steps_per_rev, n));
+    motor_state = MOTOR_RUN;
+}
 
-    for(uint32_t i = 0; i < steps_to_run; i++) {
-        gpio_put(IN1, steps[i % step_count][0]);
-        gpio_put(IN2, steps[i % step_count][1]);
-        gpio_put(IN3, steps[i % step_count][2]);
-        gpio_put(IN4, steps[i % step_count][3]);
-        sleep_ms(1);
+// Predicted duration of run N against the old fixed rate
+void plan(uint16_t steps_per_rev, uint8_t n)
+{
+    uint32_t steps = run_steps(steps_per_rev, n);
+    uint64_t planned = motion_move_time_us(&run_plan, steps);
+    uint64_t fixed = steps > 0 ? (uint64_t) (steps - 1) * 1000000 / STEP_RATE : 0;
+
+    printf("%lu steps, %lu of them ramping each way: %llu us, %llu us at %d steps/s\n", steps,
+           motion_ramp_steps(&run_plan, steps), planned, fixed, STEP_RATE);
+}
+
+// Moves on to the next stage once the stepper has finished the current one
+void motor_poll(bool *calibrated, uint16_t *steps_per_rev, uint16_t *steps_to_middle)
+{
+    if(motor_state == MOTOR_IDLE || stepper_busy()) {
+        return;
     }
 
-    turn_off();
+    switch(motor_state) {
+        case MOTOR_FIND_FORK:
+            printf("At opto fork.\n");
+            calib();
+            break;
+        case MOTOR_CALIB:
+            calib_done(calibrated, steps_per_rev, steps_to_middle);
+            go_to_middle(*steps_per_rev, *steps_to_middle);
+            break;
+        default:
+            motor_state = MOTOR_IDLE;
+            break;
+    }
 }
 
 int main(void)
@@ -157,20 +161,8 @@ int main(void)
     stdio_init_all();
     printf("Booting...\n");
 
-    init_gpio();
-
-    uint8_t steps[][4] = {
-            { 1, 0, 0, 0 },
-            { 1, 1, 0, 0 },
-            { 0, 1, 0, 0 },
-            { 0, 1, 1, 0 },
-            { 0, 0, 1, 0 },
-            { 0, 0, 1, 1 },
-            { 0, 0, 0, 1 },
-            { 1, 0, 0, 1 }
-    };
-
-    uint8_t step_count = sizeof(steps) / sizeof(steps[0]);
+    stepper_init(IN1, IN2, IN3, IN4, OPTO_FORK);
+    set_profile(true);
 
     char buf[20];
     uint8_t index = 0;
@@ -180,22 +172,38 @@ int main(void)
     uint16_t steps_to_middle = 0;
 
     while(true) {
+        motor_poll(&calibrated, &steps_per_rev, &steps_to_middle);
+
         while(uart_is_readable(UART_ID)) {
             char input_char = uart_getc(UART_ID);
             if(input_char == '\r') {
                 buf[index] = '\0';
                 if(strcmp(buf, "status") == 0) {
                     status(calibrated, steps_per_rev);
+                } else if(strcmp(buf, "stop") == 0) {
+                    stepper_stop();
+                    motor_state = MOTOR_IDLE;
+                } else if(strncmp(buf, "plan", 4) == 0) {
+                    if(calibrated) {
+                        plan(steps_per_rev, strlen(buf) > 5 ? atoi(buf + 5) : 0);
+                    } else {
+                        printf("Calibrate motor first.\n");
+                    }
+                } else if(motor_state != MOTOR_IDLE) {
+                    printf("Motor is busy.\n");
+                } else if(strcmp(buf, "trap") == 0) {
+                    set_profile(false);
+                } else if(strcmp(buf, "scurve") == 0) {
+                    set_profile(true);
                 } else if(strcmp(buf, "calib") == 0) {
-                    calib(steps, step_count, &calibrated, &steps_per_rev, &steps_to_middle);
-                    go_to_middle(steps, step_count, steps_per_rev, steps_to_middle);
+                    go_to_opto_fork();
                 } else if(strncmp(buf, "run", 3) == 0) {
                     if(calibrated) {
                         uint8_t n = 0;
                         if(strlen(buf) > 4) {
                             n = atoi(buf + 4);
                         }
-                        run(steps, step_count, steps_per_rev, n);
+                        run(steps_per_rev, n);
                     } else {
                         printf("Calibrate motor first.\n");
                     }
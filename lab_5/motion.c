@@ -0,0 +1,104 @@
+#include "motion.h"
+
+#define MOTION_TICK_HZ (1000000 / MOTION_TICK_US)
+#define FP_SHIFT 48 // position, velocity and so on in 2^-48 steps per tick^n
+
+// Integrates the profile a tick at a time and records when the position
+// crosses each whole step. Only additions per tick; the divisions are per
+// step and only happen here, never while the motor runs.
+static void motion_build(MotionPlan *plan, uint32_t max_rate, uint32_t accel, uint64_t jerk)
+{
+    uint64_t v_max = ((uint64_t) max_rate << FP_SHIFT) / MOTION_TICK_HZ;
+    uint64_t a_max = ((uint64_t) accel << FP_SHIFT) / ((uint64_t) MOTION_TICK_HZ * MOTION_TICK_HZ);
+    uint64_t pos = 0;
+    uint64_t vel = 0;
+    uint64_t acc = 0;
+    uint64_t v_rise = 0; // gained while the acceleration was rising
+    bool easing = false;
+    uint32_t ticks = 0;
+    uint64_t last_fp = 0;
+    uint16_t n = 0;
+
+    if(jerk == 0 || jerk > a_max) {
+        jerk = a_max;
+    }
+
+    while(n < MOTION_RAMP_MAX && vel < v_max) {
+        // Easing off takes as much speed as building up took, so start as
+        // soon as that would land on v_max
+        if(!easing && vel + (acc < a_max ? vel : v_rise) + acc >= v_max) {
+            easing = true;
+        }
+        if(easing) {
+            acc = acc > jerk ? acc - jerk : 0;
+            if(acc == 0) {
+                break;
+            }
+        } else if(acc < a_max) {
+            acc = acc + jerk < a_max ? acc + jerk : a_max;
+            v_rise = vel;
+        }
+
+        vel = vel + acc < v_max ? vel + acc : v_max;
+        pos += vel;
+        ticks++;
+
+        while(n < MOTION_RAMP_MAX && pos >= (uint64_t) (n + 1) << FP_SHIFT) {
+            uint64_t over = pos - ((uint64_t) (n + 1) << FP_SHIFT);
+            uint64_t t_fp = (uint64_t) ticks * MOTION_TICK_US * 256 - over * MOTION_TICK_US * 256 / vel;
+            plan->ramp_fp[n++] = t_fp - last_fp;
+            last_fp = t_fp;
+        }
+    }
+
+    plan->ramp_len = n;
+    if(n == MOTION_RAMP_MAX) {
+        plan->cruise_fp = plan->ramp_fp[n - 1];
+    } else {
+        plan->cruise_fp = (1000000u << 8) / max_rate;
+    }
+}
+
+void motion_plan_trapezoid(MotionPlan *plan, uint32_t max_rate, uint32_t accel)
+{
+    motion_build(plan, max_rate, accel, 0);
+}
+
+void motion_plan_scurve(MotionPlan *plan, uint32_t max_rate, uint32_t accel, uint32_t jerk)
+{
+    // Split up so that the shift cannot overflow
+    uint64_t j = ((uint64_t) jerk << 32) / ((uint64_t) MOTION_TICK_HZ * MOTION_TICK_HZ);
+    j = j * (1u << (FP_SHIFT - 32)) / MOTION_TICK_HZ;
+    motion_build(plan, max_rate, accel, j > 0 ? j : 1);
+}
+
+uint32_t motion_ramp_steps(const MotionPlan *plan, uint32_t steps)
+{
+    uint32_t half = steps > 0 ? (steps - 1) / 2 : 0;
+    return plan->ramp_len < half ? plan->ramp_len : half;
+}
+
+uint32_t motion_cruise_fp(const MotionPlan *plan, uint32_t steps)
+{
+    uint32_t ramp = motion_ramp_steps(plan, steps);
+
+    if(ramp >= plan->ramp_len) {
+        return plan->cruise_fp;
+    }
+    return plan->ramp_fp[ramp > 0 ? ramp - 1 : 0];
+}
+
+uint64_t motion_move_time_us(const MotionPlan *plan, uint32_t steps)
+{
+    uint32_t ramp = motion_ramp_steps(plan, steps);
+    uint64_t time_fp = 0;
+
+    if(steps < 2) {
+        return 0;
+    }
+    for(uint32_t i = 0; i < ramp; i++) {
+        time_fp += 2 * plan->ramp_fp[i];
+    }
+    time_fp += (uint64_t) (steps - 1 - 2 * ramp) * motion_cruise_fp(plan, steps);
+    return time_fp >> 8;
+}
@@ -0,0 +1,34 @@
+#ifndef MOTION_H
+#define MOTION_H
+
+#include "pico/stdlib.h"
+
+#define MOTION_RAMP_MAX 1024 // longest acceleration ramp in steps
+#define MOTION_TICK_US 8     // integration step used while planning
+
+// Step intervals for the acceleration ramp, in 1/256 us. Deceleration replays
+// the ramp backwards, so a move only needs table lookups per step.
+typedef struct MotionPlan {
+    uint16_t ramp_len;
+    uint32_t cruise_fp; // interval at full speed
+    uint32_t ramp_fp[MOTION_RAMP_MAX];
+} MotionPlan;
+
+// Constant acceleration up to `max_rate` steps/s. Rates and accelerations
+// must stay below 65536.
+void motion_plan_trapezoid(MotionPlan *plan, uint32_t max_rate, uint32_t accel);
+
+// As above, with the acceleration itself ramped at `jerk` steps/s^3
+void motion_plan_scurve(MotionPlan *plan, uint32_t max_rate, uint32_t accel, uint32_t jerk);
+
+// Time from the first to the last step of a `steps` long move
+uint64_t motion_move_time_us(const MotionPlan *plan, uint32_t steps);
+
+// Ramp steps a move of `steps` uses; short moves never reach full speed
+uint32_t motion_ramp_steps(const MotionPlan *plan, uint32_t steps);
+
+// Interval held between the two ramps. A move too short to reach full speed
+// holds the last ramp interval it got to instead.
+uint32_t motion_cruise_fp(const MotionPlan *plan, uint32_t steps);
+
+#endif
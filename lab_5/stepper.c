@@ -0,0 +1,180 @@
+#include "stepper.h"
+#include "hardware/timer.h"
+
+static const uint8_t phases[STEPPER_PHASES][4] = {
+        { 1, 0, 0, 0 },
+        { 1, 1, 0, 0 },
+        { 0, 1, 0, 0 },
+        { 0, 1, 1, 0 },
+        { 0, 0, 1, 0 },
+        { 0, 0, 1, 1 },
+        { 0, 0, 0, 1 },
+        { 1, 0, 0, 1 }
+};
+
+// The coil pins are not consecutive, which rules out a PIO out program, but
+// one masked write still switches all four at once
+static uint32_t coil_mask;
+static uint32_t phase_bits[STEPPER_PHASES];
+static uint sensor;
+static uint alarm;
+
+static volatile StepperStatus status;
+static uint32_t target_steps;
+static uint32_t stop_falls;
+static bool sensor_level;
+
+// Step times are kept in 1/256 us, so intervals shorter than a timer tick
+// are not lost while every step still lands on one. Ramp steps come from the
+// plan's table, forwards and then backwards; no arithmetic beyond that.
+static uint64_t next_fp;
+static const uint32_t *ramp_fp;
+static uint32_t ramp_steps;
+static uint32_t cruise_fp;
+
+static void stepper_finish(void)
+{
+    gpio_put_masked(coil_mask, 0);
+    status.busy = false;
+}
+
+// Returns false once the move is over
+static bool stepper_step(void)
+{
+    gpio_put_masked(coil_mask, phase_bits[status.phase]);
+    status.phase = (status.phase + 1) % STEPPER_PHASES;
+    status.steps++;
+
+    bool level = gpio_get(sensor);
+    if(!level) {
+        status.low_steps++;
+        if(sensor_level) {
+            status.falls++;
+        }
+    }
+    sensor_level = level;
+
+    if(status.steps == target_steps || (stop_falls != 0 && status.falls == stop_falls)) {
+        stepper_finish();
+        return false;
+    }
+
+    uint32_t left = target_steps - status.steps;
+    if(status.steps <= ramp_steps) {
+        next_fp += ramp_fp[status.steps - 1];
+    } else if(left <= ramp_steps) {
+        next_fp += ramp_fp[left - 1];
+    } else {
+        next_fp += cruise_fp;
+    }
+    return true;
+}
+
+static void stepper_alarm(uint alarm_num)
+{
+    if(!status.busy) {
+        return;
+    }
+
+    // A target already in the past does not fire, so steps that fell behind
+    // go out straight away
+    while(stepper_step()) {
+        if(!hardware_alarm_set_target(alarm_num, from_us_since_boot(next_fp >> 8))) {
+            return;
+        }
+        status.late++;
+    }
+}
+
+void stepper_init(uint in1, uint in2, uint in3, uint in4, uint sensor_pin)
+{
+    const uint pins[4] = { in1, in2, in3, in4 };
+
+    for(uint8_t i = 0; i < 4; i++) {
+        gpio_init(pins[i]);
+        gpio_set_dir(pins[i], GPIO_OUT);
+        coil_mask |= 1u << pins[i];
+    }
+    for(uint8_t p = 0; p < STEPPER_PHASES; p++) {
+        for(uint8_t i = 0; i < 4; i++) {
+            phase_bits[p] |= (uint32_t) phases[p][i] << pins[i];
+        }
+    }
+    gpio_put_masked(coil_mask, 0);
+
+    sensor = sensor_pin;
+    gpio_init(sensor);
+    gpio_set_dir(sensor, GPIO_IN);
+    gpio_pull_up(sensor);
+
+    alarm = hardware_alarm_claim_unused(true);
+    hardware_alarm_set_callback(alarm, stepper_alarm);
+}
+
+static bool stepper_start(uint8_t start, uint32_t steps)
+{
+    if(status.busy) {
+        return false;
+    }
+
+    status.phase = start % STEPPER_PHASES;
+    status.steps = 0;
+    status.falls = 0;
+    status.low_steps = 0;
+    status.late = 0;
+    if(steps == 0) {
+        return true;
+    }
+
+    target_steps = steps;
+    sensor_level = gpio_get(sensor);
+
+    status.busy = true;
+    next_fp = time_us_64() << 8;
+    stepper_alarm(alarm);
+    return true;
+}
+
+bool stepper_move(uint8_t start, uint32_t steps, uint32_t rate)
+{
+    if(status.busy || rate == 0) {
+        return false;
+    }
+
+    ramp_steps = 0;
+    cruise_fp = (1000000u << 8) / rate;
+    return stepper_start(start, steps);
+}
+
+bool stepper_move_plan(uint8_t start, uint32_t steps, const MotionPlan *plan)
+{
+    if(status.busy) {
+        return false;
+    }
+
+    ramp_fp = plan->ramp_fp;
+    ramp_steps = motion_ramp_steps(plan, steps);
+    cruise_fp = motion_cruise_fp(plan, steps);
+    return stepper_start(start, steps);
+}
+
+void stepper_stop_at_fall(uint32_t falls)
+{
+    stop_falls = falls;
+}
+
+void stepper_stop(void)
+{
+    hardware_alarm_cancel(alarm);
+    stepper_finish();
+}
+
+bool stepper_busy(void)
+{
+    return status.busy;
+}
+
+void stepper_get_status(StepperStatus *out)
+{
+    *out = status;
+}
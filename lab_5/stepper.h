@@ -0,0 +1,40 @@
+#ifndef STEPPER_H
+#define STEPPER_H
+
+#include "pico/stdlib.h"
+#include "motion.h"
+
+#define STEPPER_PHASES 8 // half-step sequence
+#define STEPPER_FOREVER UINT32_MAX
+
+typedef struct StepperStatus {
+    bool busy;
+    uint8_t phase;      // phase the next move should start from
+    uint32_t steps;     // taken by the current or last move
+    uint32_t falls;     // sensor falling edges seen during the move
+    uint32_t low_steps; // steps that left the sensor low
+    uint32_t late;      // steps that went out after their scheduled time
+} StepperStatus;
+
+// Coils IN1..IN4 are driven from a hardware alarm, so moves run in the
+// background. `sensor_pin` is sampled after every step.
+void stepper_init(uint in1, uint in2, uint in3, uint in4, uint sensor_pin);
+
+// Starts `steps` half-steps from phase `start` at `rate` steps/s and returns
+// at once. The coils are switched off when the move ends. Returns false if a
+// move is still running.
+bool stepper_move(uint8_t start, uint32_t steps, uint32_t rate);
+
+// As above, accelerating and decelerating along `plan`, which must stay
+// unchanged until the move ends
+bool stepper_move_plan(uint8_t start, uint32_t steps, const MotionPlan *plan);
+
+// Moves started after this end early on their `falls`-th sensor falling edge.
+// 0 lets them run their full length.
+void stepper_stop_at_fall(uint32_t falls);
+
+void stepper_stop(void);
+bool stepper_busy(void);
+void stepper_get_status(StepperStatus *status);
+
+#endif
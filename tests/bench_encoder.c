@@ -0,0 +1,189 @@
+#include <stdatomic.h>
+#include <time.h>
+#include <string.h>
+#include "check.h"
+#include "encoder.h"
+
+// Accumulator against the design it replaced: the GPIO handler pushing one
+// bool per detent into one of two 10 deep queue_t, drained by the main loop.
+// The queue below copies what queue_try_add/queue_try_remove do: take a spin
+// lock, copy the element, release.
+//
+// Part one times both paths. Part two replays spins against a main loop that
+// stalls, in simulated time, and counts what each design loses.
+
+#define BASELINE_QUEUE_LEN 10
+#define BENCH_DETENTS 5000000
+#define BENCH_DRAIN_EVERY 5
+#define SLOW_DETENT_US 100000 // far enough apart that every detent has gain 1
+
+typedef struct BaselineQueue {
+    atomic_flag lock;
+    uint8_t data[BASELINE_QUEUE_LEN];
+    uint16_t rd;
+    uint16_t wr;
+    uint16_t count;
+} BaselineQueue;
+
+static BaselineQueue clockwise;
+static BaselineQueue counterclockwise;
+
+static bool baseline_try_add(BaselineQueue *q, bool value)
+{
+    bool added = false;
+    while(atomic_flag_test_and_set_explicit(&q->lock, memory_order_acquire)) {
+    }
+    if(q->count < BASELINE_QUEUE_LEN) {
+        memcpy(&q->data[q->wr], &value, sizeof(value));
+        q->wr = (q->wr + 1) % BASELINE_QUEUE_LEN;
+        q->count++;
+        added = true;
+    }
+    atomic_flag_clear_explicit(&q->lock, memory_order_release);
+    return added;
+}
+
+static bool baseline_try_remove(BaselineQueue *q)
+{
+    bool removed = false;
+    while(atomic_flag_test_and_set_explicit(&q->lock, memory_order_acquire)) {
+    }
+    if(q->count > 0) {
+        q->rd = (q->rd + 1) % BASELINE_QUEUE_LEN;
+        q->count--;
+        removed = true;
+    }
+    atomic_flag_clear_explicit(&q->lock, memory_order_release);
+    return removed;
+}
+
+static void baseline_reset(void)
+{
+    memset(&clockwise, 0, sizeof(clockwise));
+    memset(&counterclockwise, 0, sizeof(counterclockwise));
+}
+
+// Clockwise quarter sequence, two quarters per detent
+static const uint8_t cw_states[4] = { 2, 3, 1, 0 };
+
+static uint8_t detent_phase = 3;
+
+static void encoder_detent(int8_t dir, uint32_t now_us)
+{
+    for(uint8_t q = 0; q < ENCODER_QUARTERS_PER_STEP; q++) {
+        detent_phase = (detent_phase + (dir > 0 ? 1 : 3)) % 4;
+        encoder_decode(cw_states[detent_phase], now_us);
+    }
+}
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// CPU cost of each path, producer and consumer together, with the consumer
+// draining every BENCH_DRAIN_EVERY detents so the queue never fills
+static void bench_throughput(void)
+{
+    struct timespec start;
+    int64_t received = 0;
+
+    encoder_reset(cw_states[detent_phase]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(uint32_t i = 0; i < BENCH_DETENTS; i++) {
+        encoder_detent(1, i * SLOW_DETENT_US);
+        if(i % BENCH_DRAIN_EVERY == 0) {
+            received += encoder_take_steps();
+        }
+    }
+    received += encoder_take_steps();
+    double accumulator_s = seconds_since(&start);
+
+    CHECK(received == BENCH_DETENTS);
+    CHECK(encoder_get_errors() == 0);
+
+    baseline_reset();
+    received = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(uint32_t i = 0; i < BENCH_DETENTS; i++) {
+        baseline_try_add(i & 1 ? &clockwise : &counterclockwise, true);
+        if(i % BENCH_DRAIN_EVERY == 0) {
+            while(baseline_try_remove(&clockwise)) {
+                received++;
+            }
+            while(baseline_try_remove(&counterclockwise)) {
+                received++;
+            }
+        }
+    }
+    double baseline_s = seconds_since(&start);
+
+    printf("host cost per detent, IRQ side plus main loop side:\n");
+    printf("  accumulator (2 table decodes): %6.1f ns, %6.1f M detents/s\n",
+           accumulator_s * 1e9 / BENCH_DETENTS, BENCH_DETENTS / accumulator_s / 1e6);
+    printf("  queue_t (add + remove):        %6.1f ns, %6.1f M detents/s\n",
+           baseline_s * 1e9 / BENCH_DETENTS, BENCH_DETENTS / baseline_s / 1e6);
+}
+
+// One second of spinning at `rate` detents/s against a main loop that polls
+// every millisecond, except for `stall_ms` spent in the push button debounce
+// delay. Returns the detents each design lost.
+static void simulate_stall(uint32_t rate, uint32_t stall_ms, uint32_t *accumulator_lost, uint32_t *baseline_lost)
+{
+    const uint32_t duration_us = 1000000;
+    const uint32_t stall_from_us = 300000;
+    uint32_t next_detent_us = 0;
+    int64_t accumulated = 0;
+    uint32_t detents = 0;
+    uint32_t delivered = 0;
+
+    encoder_reset(cw_states[detent_phase]);
+    baseline_reset();
+
+    for(uint32_t t = 0; t <= duration_us; t++) {
+        if(rate > 0 && t == next_detent_us && t < duration_us) {
+            encoder_detent(1, t + SLOW_DETENT_US * detents);
+            baseline_try_add(&clockwise, true);
+            detents++;
+            next_detent_us = (uint64_t) detents * 1000000 / rate;
+        }
+        bool stalled = t >= stall_from_us && t < stall_from_us + stall_ms * 1000;
+        if(t % 1000 == 0 && !stalled) {
+            accumulated += encoder_take_steps();
+            while(baseline_try_remove(&clockwise)) {
+                delivered++;
+            }
+        }
+    }
+
+    *accumulator_lost = detents - accumulated;
+    *baseline_lost = detents - delivered;
+}
+
+static void bench_stalls(void)
+{
+    const uint32_t rates[] = { 20, 50, 100, 200, 500 };
+
+    printf("\n%10s %10s %18s %18s\n", "detents/s", "stall ms", "accumulator lost", "queue_t lost");
+    for(uint8_t r = 0; r < count_of(rates); r++) {
+        for(uint32_t stall_ms = 0; stall_ms <= 100; stall_ms += 100) {
+            uint32_t accumulator_lost, baseline_lost;
+            simulate_stall(rates[r], stall_ms, &accumulator_lost, &baseline_lost);
+            CHECK(accumulator_lost == 0);
+            printf("%10lu %10lu %17.1f%% %17.1f%%\n", (unsigned long) rates[r], (unsigned long) stall_ms,
+                   100.0 * accumulator_lost / rates[r], 100.0 * baseline_lost / rates[r]);
+            if(stall_ms == 100 && rates[r] >= 200) {
+                CHECK(baseline_lost > 0);
+            }
+        }
+    }
+}
+
+int main(void)
+{
+    bench_throughput();
+    bench_stalls();
+    return check_result();
+}
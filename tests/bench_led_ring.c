@@ -0,0 +1,139 @@
+#include <string.h>
+#include "check.h"
+#include "eeprom_sim.h"
+#include "led_state.h"
+
+// Toggles the lab_4 LEDs a million times through the slot ring on the
+// simulated 24LC256, rebooting every so often, and reports how the writes
+// spread over the cells and pages. Every boot has to find the ring head by
+// binary search and come back with the last stored states.
+
+#define TOGGLES 1000000
+#define BOOT_EVERY 997
+#define ENDURANCE 1000000 // rated write cycles per page
+
+static uint32_t seed = 2463534242u;
+
+static uint32_t next_random(void)
+{
+    // xorshift32
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+}
+
+static bool same_states(LED_State *a, LED_State *b)
+{
+    for(uint8_t i = 0; i < 3; i++) {
+        if(a[i].state != b[i].state || !led_state_is_valid(&b[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Sequence number of the `n`th store, counting from 0, and where it went
+static bool slot_holds_store(uint32_t n)
+{
+    uint32_t seq;
+    uint16_t address = LED_RING_ADDR + (n % LED_SLOT_COUNT) * LED_SLOT_SIZE;
+    memcpy(&seq, &host_eeprom.mem[address], sizeof(seq));
+    return seq == n + 1;
+}
+
+int main(void)
+{
+    LED_State leds[3] = {
+            { 20, LED_OFF, ~LED_OFF },
+            { 21, LED_ON, ~LED_ON },
+            { 22, LED_OFF, ~LED_OFF },
+    };
+    uint32_t stores = 0;
+    uint32_t boots = 0;
+    uint32_t boot_reads = 0;
+    uint32_t boot_reads_max = 0;
+    uint32_t bad_boots = 0;
+
+    eeprom_sim_init(&host_eeprom, MAGIC_BYTE);
+    CHECK(!eeprom_leds_are_initialized());
+    eeprom_store_led_state_from_struct(leds);
+    stores++;
+
+    for(uint32_t t = 0; t < TOGGLES; t++) {
+        uint8_t index = next_random() % 3;
+        led_set_state(&leds[index], leds[index].state == LED_ON ? LED_OFF : LED_ON);
+        eeprom_store_led_state_from_struct(leds);
+        stores++;
+
+        if(t % BOOT_EVERY == 0) {
+            LED_State booted[3] = {
+                    { 20, LED_OFF, ~LED_OFF },
+                    { 21, LED_ON, ~LED_ON },
+                    { 22, LED_OFF, ~LED_OFF },
+            };
+            uint32_t reads = host_eeprom.reads;
+
+            bool found = eeprom_leds_are_initialized();
+            led_read_state_to_struct(booted);
+            reads = host_eeprom.reads - reads;
+
+            boots++;
+            boot_reads += reads;
+            if(reads > boot_reads_max) {
+                boot_reads_max = reads;
+            }
+            if(!found || !same_states(leds, booted)) {
+                bad_boots++;
+            }
+
+            // The next store has to land in the slot after the newest one
+            eeprom_store_led_state_from_struct(leds);
+            if(!slot_holds_store(stores)) {
+                bad_boots++;
+            }
+            stores++;
+        }
+    }
+
+    uint32_t cell_min = UINT32_MAX;
+    uint32_t cell_max = 0;
+    uint32_t page_min = UINT32_MAX;
+    uint32_t page_max = 0;
+    uint32_t outside = 0;
+
+    for(uint32_t a = 0; a < EEPROM_SIM_SIZE; a++) {
+        uint32_t n = host_eeprom.cell_writes[a];
+        if(a < LED_RING_ADDR) {
+            outside += n;
+        } else {
+            cell_min = n < cell_min ? n : cell_min;
+            cell_max = n > cell_max ? n : cell_max;
+        }
+    }
+    for(uint32_t p = LED_RING_ADDR / EEPROM_SIM_PAGE; p < EEPROM_SIM_PAGES; p++) {
+        uint32_t n = host_eeprom.page_cycles[p];
+        page_min = n < page_min ? n : page_min;
+        page_max = n > page_max ? n : page_max;
+    }
+
+    printf("%lu stores over %u slots of %u bytes, %u pages\n", (unsigned long) stores, LED_SLOT_COUNT,
+           LED_SLOT_SIZE, LED_SLOT_COUNT * LED_SLOT_SIZE / EEPROM_SIM_PAGE);
+    printf("writes per cell  min %lu max %lu\n", (unsigned long) cell_min, (unsigned long) cell_max);
+    printf("cycles per page  min %lu max %lu, %.1f%% of rated endurance\n", (unsigned long) page_min,
+           (unsigned long) page_max, 100.0 * page_max / ENDURANCE);
+    printf("rated endurance reached after ~%.0f million toggles\n",
+           (double) ENDURANCE * stores / page_max / 1e6);
+    printf("%lu boots, %.1f reads avg, %lu max to recover the ring\n", (unsigned long) boots,
+           (double) boot_reads / boots, (unsigned long) boot_reads_max);
+
+    CHECK(bad_boots == 0);
+    CHECK(outside == 0);
+    CHECK(cell_max - cell_min <= 1);
+    CHECK(cell_max == (stores + LED_SLOT_COUNT - 1) / LED_SLOT_COUNT);
+    // Slots sharing a page take turns, so pages differ by up to a pass
+    CHECK(page_max - page_min <= EEPROM_SIM_PAGE / LED_SLOT_SIZE);
+    // slot 0, six halvings, the newest sequence number and its states
+    CHECK(boot_reads_max <= 9);
+    return check_result();
+}
@@ -0,0 +1,121 @@
+#include <string.h>
+#include <time.h>
+#include "check.h"
+#include "lora_at.h"
+#include "lora_e5_sim.h"
+
+// End-to-end AT command timing against the pty simulator, which sends at the
+// UART rate like the module does. Each scenario runs the lab_3 identification
+// commands in turn with up to three attempts each and reports round-trip
+// time (first send to matching line), retries and throughput.
+
+#define BENCH_COMMANDS 24
+#define BENCH_ATTEMPTS 3
+
+typedef struct Scenario {
+    const char *name;
+    LoraSimFaults faults;
+} Scenario;
+
+static const Scenario scenarios[] = {
+        { "clean", { 0 } },
+        { "50 ms delay", { .delay_us = 50000 } },
+        { "10% ERROR", { .error_permille = 100 } },
+        { "10% no response", { .silent_permille = 100 } },
+        { "20% garbage lines", { .garbage_permille = 200 } },
+        { "0.5% bytes dropped", { .drop_permille = 5 } },
+};
+
+static const struct {
+    const char *send;
+    const char *match;
+    const char *expect;
+} commands[] = {
+        { "AT\r\n", "OK", "+AT: OK" },
+        { "AT+VER\r\n", "VER", "+VER: 4.0.11" },
+        { "AT+ID=DevEui\r\n", "ID", "+ID: DevEui, 2C:F7:F1:20:32:30:A5:70" },
+};
+
+static const char *expected;
+static uint32_t corrupt;
+
+static void check_response(AtCommand *cmd)
+{
+    if(cmd->status == AT_DONE &&
+       (cmd->response_len != strlen(expected) || memcmp(cmd->response, expected, cmd->response_len) != 0)) {
+        corrupt++;
+    }
+}
+
+static double seconds_since(const struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double) (now.tv_sec - start->tv_sec) + (double) (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void run_scenario(const Scenario *scenario, uint32_t baud_rate)
+{
+    int pid;
+    int fd = lora_sim_spawn(baud_rate, &scenario->faults, &pid);
+    struct timespec start;
+    AtStats stats;
+
+    CHECK(fd >= 0);
+    if(fd < 0) {
+        return;
+    }
+    at_init(uart1, baud_rate, 4, 5);
+    host_uart_attach(uart1, fd);
+    at_reset_stats();
+    corrupt = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(uint32_t i = 0; i < BENCH_COMMANDS; i++) {
+        AtCommand cmd = { .status = AT_IDLE };
+        expected = commands[i % count_of(commands)].expect;
+        CHECK(at_send(&cmd, commands[i % count_of(commands)].send, commands[i % count_of(commands)].match,
+                      BENCH_ATTEMPTS, check_response));
+        while(cmd.status == AT_PENDING) {
+            host_uart_service();
+            at_poll();
+            sleep_us(20);
+        }
+    }
+    double elapsed = seconds_since(&start);
+    at_get_stats(&stats);
+    lora_sim_stop(fd, pid);
+
+    printf("%-20s %6lu %4lu %4lu %7lu %5lu/%5lu/%6lu %8.0f %6.1f %5lu\n", scenario->name,
+           (unsigned long) baud_rate, (unsigned long) stats.completed, (unsigned long) stats.failed,
+           (unsigned long) stats.retries, (unsigned long) (stats.completed ? stats.rtt_min_us / 1000 : 0),
+           (unsigned long) (stats.completed ? stats.rtt_total_us / stats.completed / 1000 : 0),
+           (unsigned long) (stats.rtt_max_us / 1000), (stats.tx_bytes + stats.rx_bytes) / elapsed,
+           stats.completed / elapsed, (unsigned long) corrupt);
+
+    CHECK(stats.completed + stats.failed == BENCH_COMMANDS);
+    if(memcmp(&scenario->faults, &(LoraSimFaults) { 0 }, sizeof(LoraSimFaults)) == 0) {
+        CHECK(stats.completed == BENCH_COMMANDS);
+        CHECK(stats.retries == 0);
+        CHECK(corrupt == 0);
+    }
+    if(scenario->faults.drop_permille == 0) {
+        // Noise and errors are never taken for an answer
+        CHECK(corrupt == 0);
+        CHECK(stats.completed >= BENCH_COMMANDS * 3 / 4);
+    }
+}
+
+int main(void)
+{
+    const uint32_t rates[] = { 9600, 115200 };
+
+    printf("%-20s %6s %4s %4s %7s %17s %8s %6s %5s\n", "scenario", "baud", "ok", "fail", "retries",
+           "rtt min/avg/max ms", "B/s", "cmd/s", "bad");
+    for(uint8_t r = 0; r < count_of(rates); r++) {
+        for(uint8_t s = 0; s < count_of(scenarios); s++) {
+            run_scenario(&scenarios[s], rates[r]);
+        }
+    }
+    return check_result();
+}
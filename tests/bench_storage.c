@@ -0,0 +1,187 @@
+#include <string.h>
+#include "check.h"
+#include "eeprom_sim.h"
+#include "eeprom_log.h"
+#include "led_state.h"
+
+// Runs the lab_4 storage layer the way main.c drives it, against the
+// simulated 24LC256 at 400 kHz: each button press stores the LED states and
+// appends a log record, and every so often the board reboots, finds both
+// rings again and logs the boot. Reports what each of those costs in bus
+// and write-cycle time, how long reading back the whole log takes, and how
+// many cells every press wears.
+//
+// It is built twice. bench_storage links host_eeprom.c, which writes through
+// and waits out each write cycle before the next transfer, so the latencies
+// are those of the writes themselves. bench_storage_driver links lab_4's
+// driver on the host I2C bus and runs it as main.c does, with async writes
+// and the write-back cache flushed from eeprom_poll() between presses. That
+// cache cannot be emptied from outside, so the pages it holds survive the
+// simulated reboots and recovery there is the warm cache figure.
+
+#define EVENTS 5000
+#define BOOT_EVERY 250
+#define PRESS_GAP_US 400000
+#define ENDURANCE 1000000 // rated write cycles per page
+
+typedef struct Timing {
+    uint32_t count;
+    uint64_t total_us;
+    uint32_t max_us;
+} Timing;
+
+static void timing_add(Timing *timing, uint64_t start)
+{
+    uint32_t elapsed = time_us_64() - start;
+
+    timing->count++;
+    timing->total_us += elapsed;
+    if(elapsed > timing->max_us) {
+        timing->max_us = elapsed;
+    }
+}
+
+static uint32_t timing_avg(const Timing *timing)
+{
+    return timing->count ? timing->total_us / timing->count : 0;
+}
+
+// The main loop between presses
+static void idle(uint32_t us)
+{
+    for(uint32_t t = 0; t < us; t += 1000) {
+        host_time_advance(1000);
+        eeprom_poll();
+        log_poll();
+    }
+}
+
+typedef struct Scan {
+    uint32_t records;
+    LogRecord last;
+} Scan;
+
+static void scan_record(const LogRecord *record, void *ctx)
+{
+    Scan *scan = ctx;
+
+    if(record != NULL) {
+        scan->records++;
+        scan->last = *record;
+    }
+}
+
+static void boot(LED_State *leds, uint32_t time_s)
+{
+    LogRecord record = { .type = LOG_EVENT_BOOT, .time_s = time_s };
+
+    // Whatever is still queued or cached reaches the part first
+    eeprom_flush();
+    eeprom_wait_ready();
+    log_init();
+    log_append(&record);
+    for(uint8_t i = 0; i < 3; i++) {
+        leds[i].pin = 20 + i;
+        led_set_state(&leds[i], i == 1 ? LED_ON : LED_OFF);
+    }
+    if(!eeprom_leds_are_initialized()) {
+        eeprom_store_led_state_from_struct(leds);
+    } else {
+        led_read_state_to_struct(leds);
+    }
+}
+
+int main(void)
+{
+    LED_State leds[3];
+    LED_State booted[3];
+    Scan scan = { 0 };
+    Timing append = { 0 };
+    Timing recovery = { 0 };
+    uint32_t bad_boots = 0;
+    uint32_t time_s = 0;
+
+    eeprom_sim_init(&host_eeprom, MAGIC_BYTE);
+    host_i2c_attach(i2c1, DEV_ADDR, &eeprom_sim_target, &host_eeprom);
+    eeprom_init(i2c1, 400000, 2, 3);
+    eeprom_set_async(true);
+    boot(leds, time_s);
+
+    for(uint32_t n = 0; n < EVENTS; n++) {
+        idle(PRESS_GAP_US);
+        time_s = n * PRESS_GAP_US / 1000000;
+
+        // led_turn_on() and led_state_print_and_store()
+        uint8_t index = (n * 7 + n / 3) % 3;
+        LogRecord record = {
+            .type = LOG_EVENT_LED,
+            .led = index,
+            .state = leds[index].state != LED_ON,
+            .time_s = time_s
+        };
+        uint64_t start = time_us_64();
+        led_set_state(&leds[index], record.state ? LED_ON : LED_OFF);
+        eeprom_store_led_state_from_struct(leds);
+        log_append(&record);
+        timing_add(&append, start);
+
+        if(n % BOOT_EVERY == BOOT_EVERY - 1) {
+            idle(PRESS_GAP_US);
+            start = time_us_64();
+            boot(booted, time_s);
+            timing_add(&recovery, start);
+
+            for(uint8_t i = 0; i < 3; i++) {
+                bad_boots += booted[i].state != leds[i].state;
+            }
+        }
+    }
+
+    // Read back with nothing else going on, as the "read" command does
+    idle(PRESS_GAP_US);
+    uint64_t start = time_us_64();
+    log_for_each(scan_record, &scan);
+    uint32_t scan_us = time_us_64() - start;
+
+    uint64_t programmed = 0;
+    uint32_t cells = 0;
+    uint32_t cell_max = 0;
+    uint32_t page_max = 0;
+    for(uint32_t a = 0; a < EEPROM_SIM_SIZE; a++) {
+        programmed += host_eeprom.cell_writes[a];
+        cells += host_eeprom.cell_writes[a] > 0;
+        cell_max = host_eeprom.cell_writes[a] > cell_max ? host_eeprom.cell_writes[a] : cell_max;
+    }
+    for(uint32_t p = 0; p < EEPROM_SIM_PAGES; p++) {
+        page_max = host_eeprom.page_cycles[p] > page_max ? host_eeprom.page_cycles[p] : page_max;
+    }
+
+    EepromStats stats;
+    eeprom_get_stats(&stats);
+    uint32_t events = EVENTS + recovery.count;
+
+    printf("%u presses, %lu boots at %lu Hz\n", EVENTS, (unsigned long) recovery.count,
+           (unsigned long) stats.baud_rate);
+    printf("append        avg %6lu us, max %6lu us per press\n", (unsigned long) timing_avg(&append),
+           (unsigned long) append.max_us);
+    printf("recovery      avg %6lu us, max %6lu us per boot\n", (unsigned long) timing_avg(&recovery),
+           (unsigned long) recovery.max_us);
+    printf("full scan         %6lu us for %lu records in %u bytes\n", (unsigned long) scan_us,
+           (unsigned long) scan.records, LOG_SIZE);
+    printf("wear          %.1f cells programmed, %.2f write cycles per event, %lu cells in use\n",
+           (double) programmed / events, (double) stats.writes / events, (unsigned long) cells);
+    printf("hottest cell  %lu writes, page %lu cycles: rated endurance after ~%.1f million events\n",
+           (unsigned long) cell_max, (unsigned long) page_max, (double) ENDURANCE * events / page_max / 1e6);
+    printf("write cycle   %lu waits, %lu us avg\n", (unsigned long) stats.stalls,
+           (unsigned long) (stats.stalls ? stats.stall_total_us / stats.stalls : 0));
+    printf("cache         %lu/%lu reads hit, %lu page writes in, %lu out\n", (unsigned long) stats.cache_hits,
+           (unsigned long) (stats.cache_hits + stats.cache_misses), (unsigned long) stats.cache_writes,
+           (unsigned long) stats.cache_flushes);
+
+    CHECK(bad_boots == 0);
+    CHECK(stats.timeouts == 0);
+    CHECK(scan.records > 0 && scan.last.type == LOG_EVENT_BOOT && scan.last.time_s == time_s);
+    // The slot store's write cycle is all the log append ever waits for
+    CHECK(append.max_us < 2 * EEPROM_SIM_WRITE_US);
+    return check_result();
+}
@@ -0,0 +1,26 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+// Keeps going after a failed check so one run shows every failure. Tests
+// return check_result() from main().
+static int check_failures;
+
+#define CHECK(cond) do { \
+        if(!(cond)) { \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            check_failures++; \
+        } \
+    } while(0)
+
+static inline int check_result(void)
+{
+    if(check_failures > 0) {
+        printf("%d check(s) failed\n", check_failures);
+        return 1;
+    }
+    return 0;
+}
+
+#endif
@@ -0,0 +1,124 @@
+#include <string.h>
+#include "eeprom_sim.h"
+
+EepromSim host_eeprom;
+
+void eeprom_sim_init(EepromSim *sim, uint8_t fill)
+{
+    memset(sim, 0, sizeof(*sim));
+    memset(sim->mem, fill, sizeof(sim->mem));
+    sim->powered = true;
+}
+
+static bool sim_acks(EepromSim *sim)
+{
+    if(!sim->powered || time_us_64() < sim->busy_until_us) {
+        sim->nacks++;
+        return false;
+    }
+    return true;
+}
+
+bool eeprom_sim_write(EepromSim *sim, uint16_t address, const uint8_t *data, size_t len)
+{
+    uint16_t page = address & (EEPROM_SIM_SIZE - 1) & ~(EEPROM_SIM_PAGE - 1);
+    uint16_t offset = address & (EEPROM_SIM_PAGE - 1);
+
+    if(!sim_acks(sim)) {
+        return false;
+    }
+
+    // Only the last EEPROM_SIM_PAGE bytes of a longer write stay in the latches
+    if(len > EEPROM_SIM_PAGE) {
+        offset = (offset + len - EEPROM_SIM_PAGE) & (EEPROM_SIM_PAGE - 1);
+        data += len - EEPROM_SIM_PAGE;
+        len = EEPROM_SIM_PAGE;
+    }
+    for(size_t i = 0; i < len; i++) {
+        uint16_t cell = page + ((offset + i) & (EEPROM_SIM_PAGE - 1));
+        if(sim->cut_armed && sim->cut_left-- == 0) {
+            // Bits on their way to 0 made it, those on their way to 1 did not
+            sim->mem[cell] &= data[i];
+            sim->cell_writes[cell]++;
+            sim->powered = false;
+            sim->cut_armed = false;
+            break;
+        }
+        sim->mem[cell] = data[i];
+        sim->cell_writes[cell]++;
+    }
+    sim->page_cycles[page / EEPROM_SIM_PAGE]++;
+    sim->writes++;
+    sim->busy_until_us = time_us_64() + EEPROM_SIM_WRITE_US;
+    return true;
+}
+
+bool eeprom_sim_read(EepromSim *sim, uint16_t address, uint8_t *buffer, size_t len)
+{
+    if(!sim_acks(sim)) {
+        return false;
+    }
+    for(size_t i = 0; i < len; i++) {
+        buffer[i] = sim->mem[(address + i) & (EEPROM_SIM_SIZE - 1)];
+    }
+    sim->reads++;
+    sim->bytes_read += len;
+    return true;
+}
+
+void eeprom_sim_cut_after(EepromSim *sim, uint32_t bytes)
+{
+    sim->cut_armed = true;
+    sim->cut_left = bytes;
+}
+
+void eeprom_sim_power_on(EepromSim *sim)
+{
+    sim->powered = true;
+    sim->cut_armed = false;
+    sim->busy_until_us = 0;
+}
+
+void eeprom_sim_reset_counts(EepromSim *sim)
+{
+    memset(sim->cell_writes, 0, sizeof(sim->cell_writes));
+    memset(sim->page_cycles, 0, sizeof(sim->page_cycles));
+    sim->writes = 0;
+    sim->reads = 0;
+    sim->nacks = 0;
+    sim->bytes_read = 0;
+}
+
+static bool sim_target_ack(void *ctx)
+{
+    return sim_acks(ctx);
+}
+
+// Just the two address bytes only set the address counter, as before a read
+static void sim_target_write(void *ctx, const uint8_t *data, size_t len)
+{
+    EepromSim *sim = ctx;
+
+    if(len < 2) {
+        return;
+    }
+    sim->address = (data[0] << 8 | data[1]) & (EEPROM_SIM_SIZE - 1);
+    if(len > 2) {
+        eeprom_sim_write(sim, sim->address, data + 2, len - 2);
+        sim->address = (sim->address + len - 2) & (EEPROM_SIM_SIZE - 1);
+    }
+}
+
+static void sim_target_read(void *ctx, uint8_t *buffer, size_t len)
+{
+    EepromSim *sim = ctx;
+
+    eeprom_sim_read(sim, sim->address, buffer, len);
+    sim->address = (sim->address + len) & (EEPROM_SIM_SIZE - 1);
+}
+
+const HostI2cTarget eeprom_sim_target = {
+    .ack = sim_target_ack,
+    .write = sim_target_write,
+    .read = sim_target_read
+};
@@ -0,0 +1,65 @@
+#ifndef EEPROM_SIM_H
+#define EEPROM_SIM_H
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+// A 24LC256 at the level of its transactions: 32 KiB, written a page at a
+// time, with an endurance counter behind every cell. A write that runs past
+// the end of its page wraps to the start of the same page, as on the part.
+// Reads run on across pages and wrap at the end of memory.
+//
+// After a write the part runs its internal cycle for EEPROM_SIM_WRITE_US of
+// the host clock and NACKs its address until it is done, so drivers have to
+// ACK poll. A power cut can be armed to hit after a given number of
+// programmed bytes: the byte it lands on is left half programmed, the rest
+// of that write is lost, and the part answers nothing until powered again.
+//
+// eeprom_sim_target puts the part on the host I2C bus for the firmware
+// driver: a write transfer starts with the two address bytes, and a read
+// carries on from the part's address counter.
+
+#define EEPROM_SIM_SIZE 0x8000
+#define EEPROM_SIM_PAGE 64
+#define EEPROM_SIM_PAGES (EEPROM_SIM_SIZE / EEPROM_SIM_PAGE)
+#define EEPROM_SIM_WRITE_US 5000 // datasheet tWC
+
+typedef struct EepromSim {
+    uint8_t mem[EEPROM_SIM_SIZE];
+    uint32_t cell_writes[EEPROM_SIM_SIZE];  // bytes programmed into each cell
+    uint32_t page_cycles[EEPROM_SIM_PAGES]; // write cycles run on each page
+    uint32_t writes;
+    uint32_t reads;
+    uint32_t nacks;
+    uint64_t bytes_read;
+    uint64_t busy_until_us;
+    bool powered;
+    bool cut_armed;
+    uint32_t cut_left; // bytes still programmed before the cut
+    uint16_t address;  // where a read with no address of its own starts
+} EepromSim;
+
+// `fill` is what the cells start out holding
+void eeprom_sim_init(EepromSim *sim, uint8_t fill);
+
+// Both return false, changing nothing, if the part NACKs its address
+bool eeprom_sim_write(EepromSim *sim, uint16_t address, const uint8_t *data, size_t len);
+bool eeprom_sim_read(EepromSim *sim, uint16_t address, uint8_t *buffer, size_t len);
+
+// Cuts the power once `bytes` more bytes have been programmed
+void eeprom_sim_cut_after(EepromSim *sim, uint32_t bytes);
+
+// Brings the part back after a cut, idle and with its contents as they were
+void eeprom_sim_power_on(EepromSim *sim);
+
+// Clears the counters, keeping the contents
+void eeprom_sim_reset_counts(EepromSim *sim);
+
+// `ctx` is the EepromSim
+extern const HostI2cTarget eeprom_sim_target;
+
+// The part behind both host builds of eeprom.h: host_eeprom.c, and
+// lab_4/eeprom.c on i2c1 with eeprom_sim_target attached
+extern EepromSim host_eeprom;
+
+#endif
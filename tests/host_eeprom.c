@@ -0,0 +1,159 @@
+#include <string.h>
+#include "eeprom.h"
+#include "eeprom_sim.h"
+
+// Host build of eeprom.h over eeprom_sim: every write goes straight to the
+// part, split at page boundaries as the firmware driver splits them, and
+// waits for its write cycle the way eeprom_set_async(false) does. There is no
+// write-back cache and no request queue here, so the counts show what the
+// callers ask for rather than what the cache would save. test_eeprom and
+// bench_storage_driver run lab_4/eeprom.c itself instead.
+//
+// Bus time is charged to the host clock at the configured rate, 9 bits per
+// byte plus start and stop, so latencies come out as the part and bus would
+// make them.
+
+static EepromStats stats = {
+        .busy_min_us = UINT32_MAX, .latency_min_us = UINT32_MAX, .baud_rate = EEPROM_BAUD_STANDARD
+};
+static uint64_t stats_since_us;
+static bool write_pending;
+static uint64_t write_done_us;
+
+static void bus_time(size_t bytes)
+{
+    host_time_advance(((uint64_t) bytes * 9 + 2) * 1000000 / stats.baud_rate);
+}
+
+// Addresses the part until it ACKs, one control byte per try, as the
+// firmware ACK polls. False if it is still silent after EEPROM_WRITE_TIMEOUT_US.
+static bool host_transfer(bool write, uint16_t address, uint8_t *data, size_t len)
+{
+    uint64_t start = time_us_64();
+    bool stalled = false;
+
+    while(!(write ? eeprom_sim_write(&host_eeprom, address, data, len)
+                  : eeprom_sim_read(&host_eeprom, address, data, len))) {
+        bus_time(1);
+        stalled = true;
+        if(time_us_64() - start > EEPROM_WRITE_TIMEOUT_US) {
+            stats.timeouts++;
+            write_pending = false;
+            return false;
+        }
+    }
+    uint64_t acked_us = time_us_64();
+    bus_time(3 + len);
+
+    // As on the part, only a cycle seen ending counts towards the busy time
+    if(write_pending && stalled) {
+        uint32_t busy = acked_us - write_done_us;
+        stats.measured++;
+        stats.busy_total_us += busy;
+        stats.busy_min_us = busy < stats.busy_min_us ? busy : stats.busy_min_us;
+        stats.busy_max_us = busy > stats.busy_max_us ? busy : stats.busy_max_us;
+        stats.stalls++;
+        stats.stall_total_us += acked_us - start;
+    }
+    write_pending = write;
+    write_done_us = time_us_64();
+    stats.requests++;
+    return true;
+}
+
+void eeprom_init(i2c_inst_t *i2c, uint baud_rate, uint sda_pin, uint scl_pin)
+{
+    stats.baud_rate = baud_rate;
+    stats_since_us = time_us_64();
+}
+
+void eeprom_set_async(bool async)
+{
+}
+
+bool eeprom_wait_ready(void)
+{
+    uint8_t dummy;
+    return !write_pending || host_transfer(false, 0, &dummy, 1);
+}
+
+void eeprom_write_byte(uint16_t address, uint8_t byte)
+{
+    eeprom_write_multi_byte(address, &byte, 1);
+}
+
+uint8_t eeprom_read_byte(uint16_t address)
+{
+    uint8_t byte;
+    eeprom_read_multi_byte(address, &byte, 1);
+    return byte;
+}
+
+void eeprom_write_multi_byte(uint16_t address, const uint8_t *data, size_t len)
+{
+    while(len > 0) {
+        size_t offset = address % PAGE_SIZE;
+        size_t chunk = PAGE_SIZE - offset;
+        if(chunk > len) {
+            chunk = len;
+        }
+
+        if(host_transfer(true, address, (uint8_t *) data, chunk)) {
+            stats.writes++;
+            stats.bytes_written += chunk;
+        }
+        address += chunk;
+        data += chunk;
+        len -= chunk;
+    }
+}
+
+void eeprom_read_multi_byte(uint16_t address, uint8_t *buffer, size_t len)
+{
+    stats.cache_misses++;
+    if(!host_transfer(false, address, buffer, len)) {
+        memset(buffer, 0xFF, len); // nothing drives SDA low
+    }
+}
+
+void eeprom_scan(uint16_t address, size_t len, EepromScanCallback callback, void *ctx)
+{
+    static uint8_t chunk[EEPROM_SCAN_CHUNK];
+
+    while(len > 0) {
+        size_t n = len < EEPROM_SCAN_CHUNK ? len : EEPROM_SCAN_CHUNK;
+        if(!host_transfer(false, address, chunk, n)) {
+            memset(chunk, 0xFF, n);
+        }
+        if(!callback(address, chunk, n, ctx)) {
+            return;
+        }
+        address += n;
+        len -= n;
+    }
+}
+
+void eeprom_flush(void)
+{
+}
+
+void eeprom_poll(void)
+{
+}
+
+void eeprom_get_stats(EepromStats *out)
+{
+    *out = stats;
+    out->elapsed_us = time_us_64() - stats_since_us;
+}
+
+void eeprom_reset_stats(void)
+{
+    uint32_t baud_rate = stats.baud_rate;
+
+    memset(&stats, 0, sizeof(stats));
+    stats.baud_rate = baud_rate;
+    stats.busy_min_us = UINT32_MAX;
+    stats.latency_min_us = UINT32_MAX;
+    stats_since_us = time_us_64();
+}
@@ -0,0 +1,251 @@
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "lora_e5_sim.h"
+
+#define SIM_DEVEUI "2C:F7:F1:20:32:30:A5:70"
+#define SIM_MAX_PAYLOAD 51 // EU868 DR0
+#define SIM_GARBLED 0xFF
+
+void lora_sim_init(LoraSim *sim, int fd, uint32_t baud_rate)
+{
+    memset(sim, 0, sizeof(*sim));
+    sim->fd = fd;
+    sim->baud_rate = baud_rate;
+    sim->next_baud_rate = baud_rate;
+    sim->seed = 2463534242u;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+static bool sim_roll(LoraSim *sim, uint16_t permille)
+{
+    // xorshift32
+    sim->seed ^= sim->seed << 13;
+    sim->seed ^= sim->seed >> 17;
+    sim->seed ^= sim->seed << 5;
+    return permille > 0 && sim->seed % 1000 < permille;
+}
+
+// Rate the other end of the pty runs at, or 0 when it is not a pty
+static uint32_t sim_host_rate(LoraSim *sim)
+{
+    struct termios t;
+    if(tcgetattr(sim->fd, &t) != 0) {
+        return 0;
+    }
+    switch(cfgetospeed(&t)) {
+        case B9600: return 9600;
+        case B19200: return 19200;
+        case B38400: return 38400;
+        case B57600: return 57600;
+        case B115200: return 115200;
+        case B230400: return 230400;
+        default: return 0;
+    }
+}
+
+static bool sim_rate_matches(LoraSim *sim)
+{
+    uint32_t host = sim_host_rate(sim);
+    return host == 0 || host == sim->baud_rate;
+}
+
+static void sim_write(LoraSim *sim, const char *text)
+{
+    bool garble = !sim_rate_matches(sim);
+
+    for(; *text != '\0'; text++) {
+        char c = garble ? SIM_GARBLED : *text;
+        if(sim_roll(sim, sim->faults.drop_permille)) {
+            sim->counts.dropped++;
+            continue;
+        }
+        while(write(sim->fd, &c, 1) < 0 && errno == EAGAIN) {
+        }
+        if(sim->paced) {
+            sleep_us(10000000 / sim->baud_rate);
+        }
+    }
+}
+
+static void sim_reply(LoraSim *sim, const char *fmt, const char *arg)
+{
+    char out[LORA_SIM_LINE_LEN];
+    snprintf(out, sizeof(out), fmt, arg);
+    sim_write(sim, out);
+    sim_write(sim, "\r\n");
+}
+
+static int hex_value(char c)
+{
+    return isdigit((unsigned char) c) ? c - '0' : tolower((unsigned char) c) - 'a' + 10;
+}
+
+static void sim_msghex(LoraSim *sim, const char *arg)
+{
+    const char *end = strrchr(arg, '"');
+    size_t digits = end != NULL && arg[0] == '"' ? end - arg - 1 : 0;
+
+    if(!sim->joined) {
+        sim_reply(sim, "+MSGHEX: Please join network first", NULL);
+        return;
+    }
+    if(digits == 0 || digits % 2 != 0 || digits / 2 > SIM_MAX_PAYLOAD) {
+        sim_reply(sim, "+MSGHEX: Length error %s", "0");
+        return;
+    }
+    for(size_t i = 0; i < digits / 2; i++) {
+        if(!isxdigit((unsigned char) arg[1 + 2 * i]) || !isxdigit((unsigned char) arg[2 + 2 * i])) {
+            sim_reply(sim, "+MSGHEX: ERROR(-1)", NULL);
+            return;
+        }
+        sim->payload[i] = (hex_value(arg[1 + 2 * i]) << 4) | hex_value(arg[2 + 2 * i]);
+    }
+    sim->payload_len = digits / 2;
+    sim->frames++;
+    sim_reply(sim, "+MSGHEX: Start", NULL);
+    sim_reply(sim, "+MSGHEX: Done", NULL);
+}
+
+// "+VER" for "AT+VER", "+ID" for "AT+ID=DevEui", "+AT" for the rest
+static void sim_error(LoraSim *sim, const char *line)
+{
+    char name[16] = "AT";
+    if(strncmp(line, "AT+", 3) == 0) {
+        size_t len = strcspn(line + 3, "=");
+        len = len < sizeof(name) - 1 ? len : sizeof(name) - 1;
+        memcpy(name, line + 3, len);
+        name[len] = '\0';
+    }
+    sim_reply(sim, "+%s: ERROR(-1)", name);
+}
+
+static void sim_command(LoraSim *sim, const char *line)
+{
+    sim->counts.commands++;
+
+    if(sim_roll(sim, sim->faults.silent_permille)) {
+        sim->counts.silent++;
+        return;
+    }
+    if(sim->faults.delay_us > 0) {
+        sleep_us(sim->faults.delay_us);
+    }
+    if(sim_roll(sim, sim->faults.garbage_permille)) {
+        sim->counts.garbage++;
+        sim_write(sim, "#%&@ ~^$!\x7f*;\r\n");
+    }
+    if(sim_roll(sim, sim->faults.error_permille)) {
+        sim->counts.errors++;
+        sim_error(sim, line);
+        return;
+    }
+
+    if(strcmp(line, "AT") == 0) {
+        sim_reply(sim, "+AT: OK", NULL);
+    } else if(strcmp(line, "AT+VER") == 0) {
+        sim_reply(sim, "+VER: 4.0.11", NULL);
+    } else if(strcmp(line, "AT+ID=DevEui") == 0) {
+        sim_reply(sim, "+ID: DevEui, %s", SIM_DEVEUI);
+    } else if(strncmp(line, "AT+UART=BR, ", 12) == 0) {
+        sim->next_baud_rate = strtoul(line + 12, NULL, 10);
+        sim_reply(sim, "+UART: BR, %s", line + 12);
+    } else if(strcmp(line, "AT+RESET") == 0) {
+        sim_reply(sim, "+RESET: OK", NULL);
+        sim->baud_rate = sim->next_baud_rate;
+        sim->joined = false;
+    } else if(strcmp(line, "AT+JOIN") == 0) {
+        sim->joined = true;
+        sim_reply(sim, "+JOIN: Start", NULL);
+        sim_reply(sim, "+JOIN: NORMAL", NULL);
+        sim_reply(sim, "+JOIN: Network joined", NULL);
+        sim_reply(sim, "+JOIN: NetID 000013 DevAddr 26:0B:5A:1C", NULL);
+        sim_reply(sim, "+JOIN: Done", NULL);
+    } else if(strncmp(line, "AT+MSGHEX=", 10) == 0) {
+        sim_msghex(sim, line + 10);
+    } else {
+        sim_reply(sim, "+AT: ERROR(-1)", NULL);
+    }
+}
+
+void lora_sim_poll(LoraSim *sim)
+{
+    char buf[64];
+    ssize_t n;
+
+    while((n = read(sim->fd, buf, sizeof(buf))) > 0) {
+        bool garbled = !sim_rate_matches(sim);
+        for(ssize_t i = 0; i < n; i++) {
+            char c = garbled ? SIM_GARBLED : buf[i];
+            sim->counts.garbled += garbled;
+            if(sim->paced) {
+                // The host side queues into its FIFO faster than the line
+                // carries it
+                sleep_us(10000000 / sim->baud_rate);
+            }
+            if(c == '\n') {
+                continue;
+            }
+            if(c == '\r') {
+                sim->line[sim->line_pos] = '\0';
+                if(sim->line_pos > 0) {
+                    sim_command(sim, sim->line);
+                }
+                sim->line_pos = 0;
+            } else if(sim->line_pos < LORA_SIM_LINE_LEN - 1) {
+                sim->line[sim->line_pos++] = c;
+            }
+        }
+    }
+}
+
+int lora_sim_spawn(uint32_t baud_rate, const LoraSimFaults *faults, int *pid)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        return -1;
+    }
+    // Opened before the fork, so the child never sees the host side closed
+    // before it was ever opened
+    int host = open(ptsname(master), O_RDWR | O_NOCTTY);
+    if(host < 0) {
+        return -1;
+    }
+    struct termios t;
+    tcgetattr(host, &t);
+    cfmakeraw(&t);
+    tcsetattr(host, TCSANOW, &t);
+
+    *pid = fork();
+    if(*pid == 0) {
+        LoraSim sim;
+        close(host);
+        lora_sim_init(&sim, master, baud_rate);
+        sim.paced = true;
+        if(faults != NULL) {
+            sim.faults = *faults;
+        }
+        while(true) {
+            errno = 0;
+            lora_sim_poll(&sim);
+            if(errno == EIO) {
+                _exit(0);
+            }
+            sleep_us(50);
+        }
+    }
+    close(master);
+    return host;
+}
+
+void lora_sim_stop(int fd, int pid)
+{
+    close(fd);
+    waitpid(pid, NULL, 0);
+}
@@ -0,0 +1,69 @@
+#ifndef LORA_E5_SIM_H
+#define LORA_E5_SIM_H
+
+#include "pico/stdlib.h"
+
+// Answers the subset of the LoRa-E5 AT command set lab_3 uses, over a file
+// descriptor. Responses follow the module's own wording:
+//
+//   AT                    +AT: OK
+//   AT+VER                +VER: 4.0.11
+//   AT+ID=DevEui          +ID: DevEui, 2C:F7:F1:20:32:30:A5:70
+//   AT+UART=BR, <rate>    +UART: BR, <rate>   (applies after AT+RESET)
+//   AT+RESET              +RESET: OK
+//   AT+JOIN               +JOIN: Start ... +JOIN: Network joined ... Done
+//   AT+MSGHEX="<hex>"     +MSGHEX: Start ... +MSGHEX: Done
+//
+// Anything else gets "+AT: ERROR(-1)". Faults are drawn per command (per
+// byte for drops) from a fixed seed, so runs repeat. Over a pty the rate the
+// host side set on its end is checked too; at the wrong rate every byte in
+// either direction arrives garbled.
+
+#define LORA_SIM_LINE_LEN 160
+#define LORA_SIM_PAYLOAD_MAX 64
+
+typedef struct LoraSimFaults {
+    uint16_t error_permille;   // answer "+<CMD>: ERROR(-1)"
+    uint16_t silent_permille;  // do not answer at all
+    uint16_t garbage_permille; // send a line of noise first
+    uint16_t drop_permille;    // lose each byte sent
+    uint32_t delay_us;         // before every answer
+} LoraSimFaults;
+
+typedef struct LoraSimCounts {
+    uint32_t commands;
+    uint32_t errors;
+    uint32_t silent;
+    uint32_t garbage;
+    uint32_t dropped;
+    uint32_t garbled; // received at the wrong rate
+} LoraSimCounts;
+
+typedef struct LoraSim {
+    int fd;
+    bool paced; // send at the UART rate instead of all at once
+    LoraSimFaults faults;
+    LoraSimCounts counts;
+    uint32_t seed;
+    uint32_t baud_rate;
+    uint32_t next_baud_rate;
+    char line[LORA_SIM_LINE_LEN];
+    uint8_t line_pos;
+    bool joined;
+    uint32_t frames;
+    uint8_t payload[LORA_SIM_PAYLOAD_MAX]; // last uplink
+    uint8_t payload_len;
+} LoraSim;
+
+void lora_sim_init(LoraSim *sim, int fd, uint32_t baud_rate);
+
+// Runs a simulator on the master side of a new pty in a child process and
+// returns the host side, ready for host_uart_attach(). The child exits once
+// that side is closed.
+int lora_sim_spawn(uint32_t baud_rate, const LoraSimFaults *faults, int *pid);
+void lora_sim_stop(int fd, int pid);
+
+// Answers every complete command that has arrived. Never blocks.
+void lora_sim_poll(LoraSim *sim);
+
+#endif
@@ -0,0 +1,51 @@
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "lora_e5_sim.h"
+
+// Stand-alone simulator: prints the pty to point a serial program (or a
+// host build) at and answers on it until killed.
+//
+//   lora_e5_sim [-b baud] [-e error] [-s silent] [-g garbage] [-d drop] [-D delay_ms]
+//
+// Fault rates are per mille.
+
+int main(int argc, char **argv)
+{
+    LoraSim sim;
+    LoraSimFaults faults = { 0 };
+    uint32_t baud_rate = 9600;
+    int opt;
+
+    while((opt = getopt(argc, argv, "b:e:s:g:d:D:")) != -1) {
+        switch(opt) {
+            case 'b': baud_rate = atoi(optarg); break;
+            case 'e': faults.error_permille = atoi(optarg); break;
+            case 's': faults.silent_permille = atoi(optarg); break;
+            case 'g': faults.garbage_permille = atoi(optarg); break;
+            case 'd': faults.drop_permille = atoi(optarg); break;
+            case 'D': faults.delay_us = atoi(optarg) * 1000; break;
+            default:
+                fprintf(stderr, "usage: %s [-b baud] [-e error] [-s silent] [-g garbage] [-d drop] [-D delay_ms]\n",
+                        argv[0]);
+                return 2;
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if(master < 0 || grantpt(master) != 0 || unlockpt(master) != 0) {
+        perror("posix_openpt");
+        return 1;
+    }
+    printf("LoRa-E5 simulator at %lu baud on %s\n", (unsigned long) baud_rate, ptsname(master));
+    fflush(stdout);
+
+    lora_sim_init(&sim, master, baud_rate);
+    sim.paced = true;
+    sim.faults = faults;
+    while(true) {
+        lora_sim_poll(&sim);
+        sleep_us(100);
+    }
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "encoder.h"
+
+// Feeds edge timestamps through the quadrature table the way each lab_2
+// front end would see them, and finds the fastest spin each one decodes
+// without losing a step:
+//
+//   ideal   every edge decoded at the instant it happens
+//   irq     GPIO IRQ per edge; the pins are read IRQ_READ_NS after the
+//           handler starts and edges while it runs only leave it pending
+//   pio     the sampler program, a sample every PIO_SAMPLE_NS, pushing
+//           changes into the joined 8 deep RX FIFO that the main loop
+//           drains every `poll` ns
+//
+// Synthetic spins are used by default. A recorded trace can be replayed too:
+//   replay_quadrature trace.txt     (lines of "time_us A B")
+
+#define IRQ_READ_NS 2000 // entry, SDK GPIO dispatch, gpio_get_all()
+#define IRQ_BUSY_NS 3000 // whole handler including exit
+#define PIO_SAMPLE_NS 10000
+#define PIO_FIFO_LEN 8
+#define EDGES_MAX 100000
+
+typedef struct Edge {
+    uint64_t ns;
+    uint8_t ab; // state from this edge on
+} Edge;
+
+typedef enum Model {
+    MODEL_IDEAL,
+    MODEL_IRQ,
+    MODEL_PIO
+} Model;
+
+typedef struct Result {
+    int32_t steps;
+    uint32_t errors;
+    uint32_t overflows;
+} Result;
+
+static Edge edges[EDGES_MAX];
+static uint32_t edge_count;
+
+// Clockwise order of AB states; two quarters per detent
+static const uint8_t cw_states[4] = { 0, 2, 3, 1 };
+
+static uint8_t level_at(uint64_t ns, uint8_t start_ab, uint32_t *cursor)
+{
+    while(*cursor < edge_count && edges[*cursor].ns <= ns) {
+        (*cursor)++;
+    }
+    return *cursor > 0 ? edges[*cursor - 1].ab : start_ab;
+}
+
+static Result replay(Model model, uint8_t start_ab, uint64_t poll_ns)
+{
+    Result result = { 0 };
+    uint32_t errors_before = encoder_get_errors();
+    uint32_t cursor = 0;
+
+    encoder_reset(start_ab);
+
+    if(model == MODEL_IDEAL) {
+        for(uint32_t i = 0; i < edge_count; i++) {
+            encoder_decode(edges[i].ab, edges[i].ns / 1000);
+        }
+    } else if(model == MODEL_IRQ) {
+        uint64_t free_at = 0;
+        uint32_t next = 0;
+        while(next < edge_count) {
+            uint64_t start = edges[next].ns > free_at ? edges[next].ns : free_at;
+            // Everything up to here is acknowledged by this run
+            while(next < edge_count && edges[next].ns <= start) {
+                next++;
+            }
+            uint64_t read = start + IRQ_READ_NS;
+            encoder_decode(level_at(read, start_ab, &cursor), read / 1000);
+            free_at = start + IRQ_BUSY_NS;
+        }
+    } else {
+        Edge fifo[PIO_FIFO_LEN];
+        uint8_t fifo_count = 0;
+        uint8_t last = start_ab;
+        uint64_t end = edge_count > 0 ? edges[edge_count - 1].ns + PIO_SAMPLE_NS + poll_ns : 0;
+        uint64_t next_poll = poll_ns;
+
+        for(uint64_t t = 0; t <= end; t += PIO_SAMPLE_NS) {
+            uint8_t ab = level_at(t, start_ab, &cursor);
+            if(ab != last) {
+                last = ab;
+                if(fifo_count < PIO_FIFO_LEN) {
+                    fifo[fifo_count].ab = ab;
+                    fifo[fifo_count].ns = t;
+                    fifo_count++;
+                } else {
+                    result.overflows++; // push noblock
+                }
+            }
+            if(t >= next_poll) {
+                for(uint8_t i = 0; i < fifo_count; i++) {
+                    encoder_decode(fifo[i].ab, fifo[i].ns / 1000);
+                }
+                fifo_count = 0;
+                next_poll += poll_ns;
+            }
+        }
+    }
+
+    result.steps = encoder_take_steps();
+    result.errors = encoder_get_errors() - errors_before;
+    return result;
+}
+
+// `detents` clockwise (or back) at `edge_rate` edges/s. The two channels
+// are off quadrature by `skew`, so edges alternate between 2 * skew and
+// 2 * (1 - skew) of the mean spacing. Each edge chatters `bounces` times
+// within `bounce_ns` before it settles.
+static uint8_t spin(int32_t detents, uint32_t edge_rate, float skew, uint8_t bounces, uint32_t bounce_ns)
+{
+    uint64_t mean_ns = 1000000000ull / edge_rate;
+    uint64_t t = 1000000;
+    uint8_t phase = 0;
+    uint32_t quarters = (uint32_t) abs(detents) * ENCODER_QUARTERS_PER_STEP;
+
+    edge_count = 0;
+    for(uint32_t q = 0; q < quarters && edge_count + 2 * bounces + 1 < EDGES_MAX; q++) {
+        uint8_t from = cw_states[phase];
+        phase = (phase + (detents > 0 ? 1 : 3)) % 4;
+        uint8_t to = cw_states[phase];
+
+        for(uint8_t b = 0; b < bounces; b++) {
+            uint64_t at = t - bounce_ns + bounce_ns * b / bounces;
+            edges[edge_count++] = (Edge) { at, to };
+            edges[edge_count++] = (Edge) { at + bounce_ns / (2 * bounces), from };
+        }
+        edges[edge_count++] = (Edge) { t, to };
+        t += (uint64_t) (2 * mean_ns * (q % 2 ? 1.0f - skew : skew));
+    }
+    return cw_states[0];
+}
+
+static bool lossless(Model model, uint32_t edge_rate, float skew, uint64_t poll_ns)
+{
+    const int32_t detents = 2000;
+    uint8_t start = spin(detents, edge_rate, skew, 0, 0);
+    Result ideal = replay(MODEL_IDEAL, start, 0);
+    Result got = replay(model, start, poll_ns);
+    return got.errors == 0 && got.overflows == 0 && got.steps == ideal.steps;
+}
+
+static uint32_t max_lossless_rate(Model model, float skew, uint64_t poll_ns)
+{
+    uint32_t best = 0;
+    for(uint32_t rate = 1000; rate <= 2000000; rate += rate / 20) {
+        if(!lossless(model, rate, skew, poll_ns)) {
+            break;
+        }
+        best = rate;
+    }
+    return best;
+}
+
+static void test_table(void)
+{
+    Result r;
+
+    spin(100, 2000, 0.5f, 0, 0);
+    r = replay(MODEL_IDEAL, cw_states[0], 0);
+    CHECK(r.errors == 0);
+    CHECK(r.steps >= 100);
+
+    spin(-100, 2000, 0.5f, 0, 0);
+    r = replay(MODEL_IDEAL, cw_states[0], 0);
+    CHECK(r.errors == 0);
+    CHECK(r.steps <= -100);
+
+    // Chatter on the moving channel cancels out
+    spin(50, 100, 0.5f, 3, 200000);
+    r = replay(MODEL_IDEAL, cw_states[0], 0);
+    CHECK(r.errors == 0);
+    spin(50, 100, 0.5f, 0, 0);
+    CHECK(r.steps == replay(MODEL_IDEAL, cw_states[0], 0).steps);
+
+    // Both channels at once is an error, not a step
+    edge_count = 0;
+    edges[edge_count++] = (Edge) { 1000, 3 };
+    edges[edge_count++] = (Edge) { 2000, 0 };
+    r = replay(MODEL_IDEAL, 0, 0);
+    CHECK(r.errors == 2);
+    CHECK(r.steps == 0);
+}
+
+static void report_rates(void)
+{
+    const float skews[] = { 0.5f, 0.3f };
+
+    printf("highest edge rate decoded without loss, 2000 detents (edges/s, sweep stops at 2 M):\n");
+    printf("%-28s %10s %10s\n", "front end", "skew 0.5", "skew 0.3");
+    for(uint8_t m = 0; m < 4; m++) {
+        const char *names[] = { "ideal", "gpio irq", "pio, drained every 50 us", "pio, drained every 1 ms" };
+        const Model models[] = { MODEL_IDEAL, MODEL_IRQ, MODEL_PIO, MODEL_PIO };
+        const uint64_t polls[] = { 0, 0, 50000, 1000000 };
+        uint32_t rates[2];
+
+        for(uint8_t s = 0; s < 2; s++) {
+            rates[s] = max_lossless_rate(models[m], skews[s], polls[m]);
+        }
+        printf("%-28s %10lu %10lu\n", names[m], (unsigned long) rates[0], (unsigned long) rates[1]);
+
+        // A 20 detent/rev knob spun at 10 rev/s gives 400 edges/s
+        CHECK(rates[1] > 400);
+        if(models[m] == MODEL_PIO) {
+            // Never more than a FIFO per drain, never two edges per sample
+            CHECK(rates[0] <= 1000000000ull * PIO_FIFO_LEN / polls[m] + 1);
+            CHECK(rates[0] <= 1000000000ull / PIO_SAMPLE_NS);
+        }
+    }
+}
+
+static bool load_trace(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    double us;
+    unsigned a, b;
+
+    if(f == NULL) {
+        return false;
+    }
+    edge_count = 0;
+    while(edge_count < EDGES_MAX && fscanf(f, "%lf %u %u", &us, &a, &b) == 3) {
+        edges[edge_count++] = (Edge) { (uint64_t) (us * 1000), (uint8_t) ((a << 1) | b) };
+    }
+    fclose(f);
+    return edge_count > 0;
+}
+
+int main(int argc, char **argv)
+{
+    if(argc > 1) {
+        if(!load_trace(argv[1])) {
+            printf("cannot read %s\n", argv[1]);
+            return 1;
+        }
+        // The first line is the resting state
+        uint8_t start = edges[0].ab;
+        Result ideal = replay(MODEL_IDEAL, start, 0);
+        Result irq = replay(MODEL_IRQ, start, 0);
+        Result pio = replay(MODEL_PIO, start, 50000);
+        printf("%lu edges: ideal %ld steps %lu errors, irq %ld steps %lu errors, pio %ld steps %lu errors %lu overflows\n",
+               (unsigned long) edge_count, (long) ideal.steps, (unsigned long) ideal.errors, (long) irq.steps,
+               (unsigned long) irq.errors, (long) pio.steps, (unsigned long) pio.errors, (unsigned long) pio.overflows);
+        return 0;
+    }
+
+    test_table();
+    report_rates();
+    return check_result();
+}
@@ -0,0 +1,59 @@
+#include <string.h>
+#include "hardware/pwm.h"
+
+static pwm_hw_t registers;
+pwm_hw_t *pwm_hw = &registers;
+uint32_t host_pwm_cc_writes[NUM_PWM_SLICES];
+
+pwm_config pwm_get_default_config(void)
+{
+    pwm_config c = { 0, 1 << 4, 0xFFFF };
+    return c;
+}
+
+void pwm_config_set_clkdiv_int(pwm_config *c, uint div)
+{
+    c->div = div << 4;
+}
+
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap)
+{
+    c->top = wrap;
+}
+
+void pwm_init(uint slice_num, pwm_config *c, bool start)
+{
+    pwm_slice_hw_t *slice = &registers.slice[slice_num];
+    slice->csr = 0;
+    slice->ctr = 0;
+    slice->cc = 0;
+    slice->top = c->top;
+    slice->div = c->div;
+    pwm_set_enabled(slice_num, start);
+}
+
+void pwm_set_enabled(uint slice_num, bool enabled)
+{
+    if(enabled) {
+        registers.en |= 1u << slice_num;
+    } else {
+        registers.en &= ~(1u << slice_num);
+    }
+}
+
+void pwm_set_mask_enabled(uint32_t mask)
+{
+    registers.en = mask;
+}
+
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b)
+{
+    registers.slice[slice_num].cc = ((uint32_t) level_b << PWM_CH0_CC_B_LSB) | level_a;
+    host_pwm_cc_writes[slice_num]++;
+}
+
+void host_pwm_reset(void)
+{
+    memset(&registers, 0, sizeof(registers));
+    memset(host_pwm_cc_writes, 0, sizeof(host_pwm_cc_writes));
+}
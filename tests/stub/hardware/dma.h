@@ -0,0 +1,108 @@
+#ifndef HOST_HARDWARE_DMA_H
+#define HOST_HARDWARE_DMA_H
+
+#include "pico/stdlib.h"
+
+// Channels only record what they were configured with. A transfer paced by
+// a peripheral's DREQ is carried out by that peripheral's model, which finds
+// it with host_dma_paced_by(). Unpaced transfers do nothing and the sniffer
+// always reads 0, so users that check the sniffer take their software
+// fallbacks.
+
+#define NUM_DMA_CHANNELS 12
+
+#define DMA_SNIFF_CTRL_CALC_VALUE_CRC16 0x2
+
+#define DREQ_I2C0_TX 32
+#define DREQ_I2C0_RX 33
+#define DREQ_I2C1_TX 34
+#define DREQ_I2C1_RX 35
+#define DREQ_FORCE 0x3f
+
+enum dma_channel_transfer_size {
+    DMA_SIZE_8 = 0,
+    DMA_SIZE_16 = 1,
+    DMA_SIZE_32 = 2
+};
+
+typedef struct {
+    enum dma_channel_transfer_size size;
+    uint dreq;
+} dma_channel_config;
+
+typedef struct host_dma_channel {
+    volatile void *write_addr;
+    const volatile void *read_addr;
+    uint transfer_count;
+    enum dma_channel_transfer_size size;
+    uint dreq;
+    bool busy;
+} host_dma_channel_t;
+
+int dma_claim_unused_channel(bool required);
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_abort(uint channel);
+
+// The busy channel paced by `dreq`, or NULL
+host_dma_channel_t *host_dma_paced_by(uint dreq);
+
+static inline dma_channel_config dma_channel_get_default_config(uint channel)
+{
+    (void) channel;
+    return (dma_channel_config) { .size = DMA_SIZE_32, .dreq = DREQ_FORCE };
+}
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+    c->size = size;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+    c->dreq = dreq;
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+    (void) c;
+    (void) incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+    (void) c;
+    (void) incr;
+}
+
+static inline void channel_config_set_sniff_enable(dma_channel_config *c, bool sniff)
+{
+    (void) c;
+    (void) sniff;
+}
+
+// Paced transfers are over by the time their peripheral says so
+static inline void dma_channel_wait_for_finish_blocking(uint channel)
+{
+    (void) channel;
+}
+
+static inline void dma_sniffer_enable(uint channel, uint mode, bool force_channel_enable)
+{
+    (void) channel;
+    (void) mode;
+    (void) force_channel_enable;
+}
+
+static inline void dma_sniffer_set_data_accumulator(uint32_t seed)
+{
+    (void) seed;
+}
+
+static inline uint32_t dma_sniffer_get_data_accumulator(void)
+{
+    return 0;
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef HOST_HARDWARE_GPIO_H
+#define HOST_HARDWARE_GPIO_H
+
+#include "pico/stdlib.h"
+
+enum gpio_function {
+    GPIO_FUNC_UART = 2,
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_PWM = 4,
+    GPIO_FUNC_NULL = 0x1f
+};
+
+#define GPIO_OUT 1
+#define GPIO_IN 0
+
+// Pin muxing has no effect on the host
+static inline void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    (void) gpio;
+    (void) fn;
+}
+
+// Nor do the pins themselves; inputs read high, as if pulled up
+static inline void gpio_init(uint gpio)
+{
+    (void) gpio;
+}
+
+static inline void gpio_set_dir(uint gpio, bool out)
+{
+    (void) gpio;
+    (void) out;
+}
+
+static inline void gpio_pull_up(uint gpio)
+{
+    (void) gpio;
+}
+
+static inline void gpio_put_masked(uint32_t mask, uint32_t value)
+{
+    (void) mask;
+    (void) value;
+}
+
+static inline bool gpio_get(uint gpio)
+{
+    (void) gpio;
+    return true;
+}
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef HOST_HARDWARE_I2C_H
+#define HOST_HARDWARE_I2C_H
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+
+// The RP2040 I2C controller as far as lab_4's driver uses it. A transfer is
+// the words a DMA channel paced by the TX DREQ feeds into data_cmd: bytes to
+// write, then read commands, the last with STOP set. It takes the time its
+// bits would at the configured rate, and at the end the read bytes go to the
+// channel paced by the RX DREQ and STOP_DET is raised, with TX_ABRT as well
+// if the target NACKed its address. Completed transfers are delivered from
+// tight_loop_contents() and host_time_advance().
+//
+// Reading the clear registers has no effect; the model drops the interrupt
+// bits it raised once the handler returns.
+
+#define I2C_IC_DATA_CMD_CMD_BITS 0x00000100
+#define I2C_IC_DATA_CMD_STOP_BITS 0x00000200
+#define I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS 0x00000040
+#define I2C_IC_RAW_INTR_STAT_STOP_DET_BITS 0x00000200
+#define I2C_IC_INTR_MASK_M_TX_ABRT_BITS 0x00000040
+#define I2C_IC_INTR_MASK_M_STOP_DET_BITS 0x00000200
+#define I2C_IC_DMA_CR_RDMAE_BITS 0x00000001
+#define I2C_IC_DMA_CR_TDMAE_BITS 0x00000002
+
+#define PICO_ERROR_GENERIC (-1)
+
+typedef struct {
+    volatile uint32_t tar;
+    volatile uint32_t data_cmd;
+    volatile uint32_t enable;
+    volatile uint32_t intr_mask;
+    volatile uint32_t raw_intr_stat;
+    volatile uint32_t clr_intr;
+    volatile uint32_t clr_tx_abrt;
+    volatile uint32_t clr_stop_det;
+    volatile uint32_t dma_cr;
+} i2c_hw_t;
+
+typedef struct i2c_inst i2c_inst_t;
+
+i2c_inst_t *host_i2c_instance(uint index);
+#define i2c0 host_i2c_instance(0)
+#define i2c1 host_i2c_instance(1)
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate);
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c);
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx);
+
+// Blocking transfers; the clock moves on by their bus time
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us);
+
+// A device on the bus at the level of its transfers. `ack` says whether it
+// answers its address now; `write` and `read` are only called once it has.
+typedef struct HostI2cTarget {
+    bool (*ack)(void *ctx);
+    void (*write)(void *ctx, const uint8_t *data, size_t len);
+    void (*read)(void *ctx, uint8_t *buffer, size_t len);
+} HostI2cTarget;
+
+// Puts `target` on the bus at 7-bit address `addr`
+void host_i2c_attach(i2c_inst_t *i2c, uint8_t addr, const HostI2cTarget *target, void *ctx);
+
+// When the earliest transfer that can interrupt now ends. False if none is
+// in flight.
+bool host_i2c_next_due(uint64_t *due);
+
+// Finishes the transfer host_i2c_next_due() named and runs the handler
+void host_i2c_finish(void);
+
+// Waits out the next transfer, as a busy-wait loop on the board would
+void host_i2c_service(void);
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef HOST_HARDWARE_IRQ_H
+#define HOST_HARDWARE_IRQ_H
+
+#include "pico/stdlib.h"
+
+#define UART0_IRQ 20
+#define UART1_IRQ 21
+#define I2C0_IRQ 23
+#define I2C1_IRQ 24
+
+typedef void (*irq_handler_t)(void);
+
+// Handlers never preempt anything on the host; the peripheral models call
+// them where the test decides an interrupt would have fired
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+// True if `num` has a handler and is enabled
+bool host_irq_ready(uint num);
+
+// Runs the handler of `num` if it is ready. False if not.
+bool host_irq_call(uint num);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef HOST_HARDWARE_PWM_H
+#define HOST_HARDWARE_PWM_H
+
+#include "pico/stdlib.h"
+
+// A register file in place of the PWM block. Tests look at the registers and
+// at how often CC was written.
+
+#define NUM_PWM_SLICES 8
+#define PWM_CHAN_A 0
+#define PWM_CHAN_B 1
+#define PWM_CH0_CC_A_LSB 0
+#define PWM_CH0_CC_B_LSB 16
+
+typedef struct pwm_slice_hw_t {
+    uint32_t csr;
+    uint32_t div;
+    uint32_t ctr;
+    uint32_t cc;
+    uint32_t top;
+} pwm_slice_hw_t;
+
+typedef struct pwm_hw_t {
+    pwm_slice_hw_t slice[NUM_PWM_SLICES];
+    uint32_t en;
+} pwm_hw_t;
+
+typedef struct pwm_config {
+    uint32_t csr;
+    uint32_t div;
+    uint32_t top;
+} pwm_config;
+
+extern pwm_hw_t *pwm_hw;
+extern uint32_t host_pwm_cc_writes[NUM_PWM_SLICES];
+
+static inline uint pwm_gpio_to_slice_num(uint gpio)
+{
+    return (gpio >> 1) & 7;
+}
+
+static inline uint pwm_gpio_to_channel(uint gpio)
+{
+    return gpio & 1;
+}
+
+pwm_config pwm_get_default_config(void);
+void pwm_config_set_clkdiv_int(pwm_config *c, uint div);
+void pwm_config_set_wrap(pwm_config *c, uint16_t wrap);
+void pwm_init(uint slice_num, pwm_config *c, bool start);
+void pwm_set_enabled(uint slice_num, bool enabled);
+void pwm_set_mask_enabled(uint32_t mask);
+void pwm_set_both_levels(uint slice_num, uint16_t level_a, uint16_t level_b);
+
+void host_pwm_reset(void);
+
+#endif
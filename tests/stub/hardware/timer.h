@@ -0,0 +1,26 @@
+#ifndef HOST_HARDWARE_TIMER_H
+#define HOST_HARDWARE_TIMER_H
+
+#include "pico/stdlib.h"
+
+// One hardware alarm, fired by the test rather than by the timer
+
+typedef void (*hardware_alarm_callback_t)(uint alarm_num);
+
+static inline absolute_time_t from_us_since_boot(uint64_t us)
+{
+    return us;
+}
+
+int hardware_alarm_claim_unused(bool required);
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback);
+
+// As on the board, true if `target` has already passed, leaving the alarm unset
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t target);
+void hardware_alarm_cancel(uint alarm_num);
+
+// Moves the clock on to the alarm's target, if it is later, and runs the
+// callback. False if no alarm is set.
+bool host_alarm_fire(void);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef HOST_HARDWARE_UART_H
+#define HOST_HARDWARE_UART_H
+
+#include "pico/stdlib.h"
+#include "hardware/irq.h"
+
+// A UART on top of a file descriptor, normally a pty or a socket with the
+// simulated module on the other end. The RX and TX FIFOs are 32 deep like
+// the PL011's, and TX drains at the configured baud rate in real time, so
+// blocking writes cost what they would on the board.
+
+#define UART_FIFO_LEN 32
+
+typedef struct uart_inst uart_inst_t;
+
+uart_inst_t *host_uart_instance(uint index);
+#define uart0 host_uart_instance(0)
+#define uart1 host_uart_instance(1)
+
+uint uart_init(uart_inst_t *uart, uint baud_rate);
+uint uart_set_baudrate(uart_inst_t *uart, uint baud_rate);
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data);
+
+bool uart_is_readable(uart_inst_t *uart);
+char uart_getc(uart_inst_t *uart);
+bool uart_is_writable(uart_inst_t *uart);
+void uart_putc_raw(uart_inst_t *uart, char c);
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len);
+void uart_tx_wait_blocking(uart_inst_t *uart);
+
+// Connects the UART to `fd`, which is switched to non-blocking
+void host_uart_attach(uart_inst_t *uart, int fd);
+
+// Runs the UART interrupt handlers whose interrupt would be asserted: RX
+// data waiting, or the TX FIFO at or below half full
+void host_uart_service(void);
+
+// Time spent inside uart_write_blocking() and uart_tx_wait_blocking()
+uint64_t host_uart_blocked_us(uart_inst_t *uart);
+
+#endif
@@ -0,0 +1,45 @@
+#include "hardware/timer.h"
+
+static hardware_alarm_callback_t alarm_callback;
+static bool armed;
+static uint64_t target_us;
+
+int hardware_alarm_claim_unused(bool required)
+{
+    (void) required;
+    return 0;
+}
+
+void hardware_alarm_set_callback(uint alarm_num, hardware_alarm_callback_t callback)
+{
+    (void) alarm_num;
+    alarm_callback = callback;
+}
+
+bool hardware_alarm_set_target(uint alarm_num, absolute_time_t target)
+{
+    (void) alarm_num;
+    armed = target > time_us_64();
+    target_us = target;
+    return !armed;
+}
+
+void hardware_alarm_cancel(uint alarm_num)
+{
+    (void) alarm_num;
+    armed = false;
+}
+
+bool host_alarm_fire(void)
+{
+    if(!armed || alarm_callback == NULL) {
+        return false;
+    }
+    uint64_t now = time_us_64();
+    if(target_us > now) {
+        host_time_advance(target_us - now);
+    }
+    armed = false;
+    alarm_callback(0);
+    return true;
+}
@@ -0,0 +1,49 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "hardware/dma.h"
+
+static host_dma_channel_t channels[NUM_DMA_CHANNELS];
+static bool claimed[NUM_DMA_CHANNELS];
+
+int dma_claim_unused_channel(bool required)
+{
+    for(uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if(!claimed[i]) {
+            claimed[i] = true;
+            return i;
+        }
+    }
+    if(required) {
+        printf("No DMA channels available\n");
+        abort();
+    }
+    return -1;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger)
+{
+    host_dma_channel_t *ch = &channels[channel];
+
+    ch->write_addr = write_addr;
+    ch->read_addr = read_addr;
+    ch->transfer_count = transfer_count;
+    ch->size = config->size;
+    ch->dreq = config->dreq;
+    ch->busy = trigger && config->dreq != DREQ_FORCE;
+}
+
+void dma_channel_abort(uint channel)
+{
+    channels[channel].busy = false;
+}
+
+host_dma_channel_t *host_dma_paced_by(uint dreq)
+{
+    for(uint i = 0; i < NUM_DMA_CHANNELS; i++) {
+        if(channels[i].busy && channels[i].dreq == dreq) {
+            return &channels[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,193 @@
+#include <string.h>
+#include "hardware/dma.h"
+#include "hardware/i2c.h"
+
+#define I2C_MAX_TRANSFER 512
+
+struct i2c_inst {
+    i2c_hw_t hw;
+    uint index;
+    uint baud_rate;
+    uint8_t target_addr;
+    const HostI2cTarget *target;
+    void *target_ctx;
+
+    // The transfer in flight, taken off the TX channel when it starts
+    bool active;
+    bool acked;
+    uint8_t write[I2C_MAX_TRANSFER];
+    size_t write_len;
+    size_t read_len;
+    uint64_t due_us;
+};
+
+static struct i2c_inst i2cs[2] = { { .index = 0 }, { .index = 1 } };
+static i2c_inst_t *due_i2c;
+
+i2c_inst_t *host_i2c_instance(uint index)
+{
+    return &i2cs[index];
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate)
+{
+    i2c->hw.enable = 1;
+    return i2c_set_baudrate(i2c, baudrate);
+}
+
+uint i2c_set_baudrate(i2c_inst_t *i2c, uint baudrate)
+{
+    i2c->baud_rate = baudrate;
+    return baudrate;
+}
+
+i2c_hw_t *i2c_get_hw(i2c_inst_t *i2c)
+{
+    return &i2c->hw;
+}
+
+uint i2c_get_dreq(i2c_inst_t *i2c, bool is_tx)
+{
+    return (i2c->index == 0 ? DREQ_I2C0_TX : DREQ_I2C1_TX) + !is_tx;
+}
+
+void host_i2c_attach(i2c_inst_t *i2c, uint8_t addr, const HostI2cTarget *target, void *ctx)
+{
+    i2c->target_addr = addr;
+    i2c->target = target;
+    i2c->target_ctx = ctx;
+}
+
+static bool target_acks(i2c_inst_t *i2c, uint8_t addr)
+{
+    return i2c->target != NULL && addr == i2c->target_addr && i2c->target->ack(i2c->target_ctx);
+}
+
+// START, the address byte and STOP, plus 9 bits for every byte after it
+static uint64_t bus_us(i2c_inst_t *i2c, size_t bytes)
+{
+    return ((uint64_t) (bytes + 1) * 9 + 2) * 1000000 / i2c->baud_rate;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len, bool nostop,
+                         uint timeout_us)
+{
+    (void) nostop;
+    (void) timeout_us;
+
+    if(!target_acks(i2c, addr)) {
+        host_time_advance(bus_us(i2c, 0));
+        return PICO_ERROR_GENERIC;
+    }
+    host_time_advance(bus_us(i2c, len));
+    i2c->target->write(i2c->target_ctx, src, len);
+    return len;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len, bool nostop, uint timeout_us)
+{
+    (void) nostop;
+    (void) timeout_us;
+
+    if(!target_acks(i2c, addr)) {
+        host_time_advance(bus_us(i2c, 0));
+        return PICO_ERROR_GENERIC;
+    }
+    host_time_advance(bus_us(i2c, len));
+    i2c->target->read(i2c->target_ctx, dst, len);
+    return len;
+}
+
+// Picks up a transfer the driver has handed to the TX channel. The address
+// byte goes out first, so whether the target ACKs is settled here.
+static void i2c_start(i2c_inst_t *i2c)
+{
+    host_dma_channel_t *tx = host_dma_paced_by(i2c_get_dreq(i2c, true));
+
+    if(i2c->active || tx == NULL || !i2c->hw.enable || tx->write_addr != &i2c->hw.data_cmd) {
+        return;
+    }
+
+    const uint16_t *words = (const uint16_t *) tx->read_addr;
+    i2c->write_len = 0;
+    i2c->read_len = 0;
+    for(uint i = 0; i < tx->transfer_count && i < I2C_MAX_TRANSFER; i++) {
+        if(words[i] & I2C_IC_DATA_CMD_CMD_BITS) {
+            i2c->read_len++;
+        } else {
+            i2c->write[i2c->write_len++] = words[i];
+        }
+    }
+
+    i2c->active = true;
+    i2c->acked = target_acks(i2c, i2c->hw.tar);
+    if(!i2c->acked) {
+        i2c->due_us = time_us_64() + bus_us(i2c, 0);
+    } else {
+        // A read after written bytes costs a repeated START and address byte
+        size_t bytes = i2c->write_len + i2c->read_len + (i2c->write_len > 0 && i2c->read_len > 0);
+        i2c->due_us = time_us_64() + bus_us(i2c, bytes);
+    }
+}
+
+bool host_i2c_next_due(uint64_t *due)
+{
+    due_i2c = NULL;
+    for(uint i = 0; i < count_of(i2cs); i++) {
+        i2c_inst_t *i2c = &i2cs[i];
+        i2c_start(i2c);
+        if(i2c->active && host_irq_ready(i2c->index == 0 ? I2C0_IRQ : I2C1_IRQ) &&
+           (due_i2c == NULL || i2c->due_us < due_i2c->due_us)) {
+            due_i2c = i2c;
+        }
+    }
+    if(due_i2c != NULL) {
+        *due = due_i2c->due_us;
+    }
+    return due_i2c != NULL;
+}
+
+void host_i2c_finish(void)
+{
+    i2c_inst_t *i2c = due_i2c;
+    host_dma_channel_t *tx = host_dma_paced_by(i2c_get_dreq(i2c, true));
+    host_dma_channel_t *rx = host_dma_paced_by(i2c_get_dreq(i2c, false));
+    uint32_t raised = I2C_IC_RAW_INTR_STAT_STOP_DET_BITS;
+
+    due_i2c = NULL;
+    if(!i2c->acked) {
+        raised |= I2C_IC_RAW_INTR_STAT_TX_ABRT_BITS;
+    } else {
+        if(i2c->write_len > 0) {
+            i2c->target->write(i2c->target_ctx, i2c->write, i2c->write_len);
+        }
+        if(i2c->read_len > 0) {
+            static uint8_t read[I2C_MAX_TRANSFER];
+            i2c->target->read(i2c->target_ctx, read, i2c->read_len);
+            if(rx != NULL && rx->read_addr == &i2c->hw.data_cmd) {
+                size_t n = rx->transfer_count < i2c->read_len ? rx->transfer_count : i2c->read_len;
+                memcpy((void *) rx->write_addr, read, n);
+                rx->busy = false;
+            }
+        }
+        tx->busy = false;
+    }
+    i2c->active = false;
+
+    // On an abort the channels are left running for the handler to stop
+    i2c->hw.raw_intr_stat |= raised;
+    if(raised & i2c->hw.intr_mask) {
+        host_irq_call(i2c->index == 0 ? I2C0_IRQ : I2C1_IRQ);
+    }
+    i2c->hw.raw_intr_stat &= ~raised;
+}
+
+void host_i2c_service(void)
+{
+    uint64_t due;
+
+    if(host_i2c_next_due(&due)) {
+        uint64_t now = time_us_64();
+        host_time_advance(due > now ? due - now : 0);
+    }
+}
@@ -0,0 +1,37 @@
+#include "hardware/i2c.h"
+#include "hardware/irq.h"
+
+#define IRQ_COUNT 32
+
+static irq_handler_t handlers[IRQ_COUNT];
+static bool enabled[IRQ_COUNT];
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler)
+{
+    handlers[num] = handler;
+}
+
+void irq_set_enabled(uint num, bool on)
+{
+    enabled[num] = on;
+}
+
+bool host_irq_ready(uint num)
+{
+    return handlers[num] != NULL && enabled[num];
+}
+
+bool host_irq_call(uint num)
+{
+    if(!host_irq_ready(num)) {
+        return false;
+    }
+    handlers[num]();
+    return true;
+}
+
+void host_irq_service(void)
+{
+    host_uart_service();
+    host_i2c_service();
+}
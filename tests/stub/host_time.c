@@ -0,0 +1,77 @@
+#include <time.h>
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+static uint64_t skipped_us;
+static bool frozen;
+static uint64_t frozen_us;
+
+static uint64_t host_clock_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+uint64_t time_us_64(void)
+{
+    static uint64_t boot_us;
+    if(boot_us == 0) {
+        boot_us = host_clock_us();
+    }
+    return (frozen ? frozen_us : host_clock_us() - boot_us) + skipped_us;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t) time_us_64();
+}
+
+absolute_time_t get_absolute_time(void)
+{
+    return time_us_64();
+}
+
+uint32_t to_ms_since_boot(absolute_time_t t)
+{
+    return (uint32_t) (t / 1000);
+}
+
+void sleep_us(uint64_t us)
+{
+    struct timespec ts = { (time_t) (us / 1000000), (long) (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_us((uint64_t) ms * 1000);
+}
+
+static void skip_to(uint64_t target)
+{
+    uint64_t now = time_us_64();
+    if(target > now) {
+        skipped_us += target - now;
+    }
+}
+
+void host_time_advance(uint64_t us)
+{
+    uint64_t target = time_us_64() + us;
+    uint64_t due;
+
+    // Transfers that end on the way finish at their own time, so their
+    // interrupts see the clock they would have on the board
+    while(host_i2c_next_due(&due) && due <= target) {
+        skip_to(due);
+        host_i2c_finish();
+    }
+    skip_to(target);
+}
+
+void host_time_freeze(void)
+{
+    frozen_us = time_us_64() - skipped_us;
+    frozen = true;
+}
@@ -0,0 +1,175 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "hardware/uart.h"
+
+#define TX_IRQ_LEVEL (UART_FIFO_LEN / 2)
+
+struct uart_inst {
+    int fd;
+    uint baud_rate;
+    bool rx_irq;
+    bool tx_irq;
+    uint8_t rx_fifo[UART_FIFO_LEN];
+    uint8_t rx_pos;
+    uint8_t rx_len;
+    uint64_t tx_empty_ns; // when the last queued byte has left the wire
+    uint64_t blocked_ns;
+};
+
+static struct uart_inst uarts[2] = { { .fd = -1 }, { .fd = -1 } };
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static uint64_t byte_ns(uart_inst_t *uart)
+{
+    return 10ull * 1000000000 / uart->baud_rate;
+}
+
+uart_inst_t *host_uart_instance(uint index)
+{
+    return &uarts[index];
+}
+
+// On a pty the rate is handed on to the other side, which can then tell when
+// the two ends disagree
+static void apply_rate(uart_inst_t *uart)
+{
+    const uint rates[] = { 9600, 19200, 38400, 57600, 115200, 230400 };
+    const speed_t speeds[] = { B9600, B19200, B38400, B57600, B115200, B230400 };
+    struct termios t;
+
+    if(uart->fd < 0 || tcgetattr(uart->fd, &t) != 0) {
+        return;
+    }
+    cfmakeraw(&t);
+    for(uint i = 0; i < count_of(rates); i++) {
+        if(rates[i] == uart->baud_rate) {
+            cfsetspeed(&t, speeds[i]);
+        }
+    }
+    tcsetattr(uart->fd, TCSANOW, &t);
+}
+
+uint uart_init(uart_inst_t *uart, uint baud_rate)
+{
+    uart->rx_pos = 0;
+    uart->rx_len = 0;
+    uart->tx_empty_ns = 0;
+    return uart_set_baudrate(uart, baud_rate);
+}
+
+uint uart_set_baudrate(uart_inst_t *uart, uint baud_rate)
+{
+    uart->baud_rate = baud_rate;
+    apply_rate(uart);
+    return baud_rate;
+}
+
+void uart_set_irq_enables(uart_inst_t *uart, bool rx_has_data, bool tx_needs_data)
+{
+    uart->rx_irq = rx_has_data;
+    uart->tx_irq = tx_needs_data;
+}
+
+bool uart_is_readable(uart_inst_t *uart)
+{
+    if(uart->rx_pos == uart->rx_len && uart->fd >= 0) {
+        ssize_t n = read(uart->fd, uart->rx_fifo, UART_FIFO_LEN);
+        uart->rx_pos = 0;
+        uart->rx_len = n > 0 ? n : 0;
+    }
+    return uart->rx_pos < uart->rx_len;
+}
+
+char uart_getc(uart_inst_t *uart)
+{
+    while(!uart_is_readable(uart)) {
+        sleep_us(100);
+    }
+    return uart->rx_fifo[uart->rx_pos++];
+}
+
+static uint32_t tx_level(uart_inst_t *uart)
+{
+    uint64_t now = now_ns();
+    if(uart->tx_empty_ns <= now) {
+        return 0;
+    }
+    return (uart->tx_empty_ns - now + byte_ns(uart) - 1) / byte_ns(uart);
+}
+
+bool uart_is_writable(uart_inst_t *uart)
+{
+    return tx_level(uart) < UART_FIFO_LEN;
+}
+
+void uart_putc_raw(uart_inst_t *uart, char c)
+{
+    uint64_t start = now_ns();
+    while(!uart_is_writable(uart)) {
+    }
+    uart->blocked_ns += now_ns() - start;
+
+    uint64_t now = now_ns();
+    uart->tx_empty_ns = (uart->tx_empty_ns > now ? uart->tx_empty_ns : now) + byte_ns(uart);
+    if(uart->fd >= 0) {
+        while(write(uart->fd, &c, 1) < 0 && errno == EAGAIN) {
+        }
+    }
+}
+
+void uart_write_blocking(uart_inst_t *uart, const uint8_t *src, size_t len)
+{
+    for(size_t i = 0; i < len; i++) {
+        uart_putc_raw(uart, src[i]);
+    }
+}
+
+void uart_tx_wait_blocking(uart_inst_t *uart)
+{
+    uint64_t start = now_ns();
+    while(tx_level(uart) > 0) {
+    }
+    uart->blocked_ns += now_ns() - start;
+}
+
+void host_uart_attach(uart_inst_t *uart, int fd)
+{
+    uart->fd = fd;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    apply_rate(uart);
+}
+
+void host_uart_service(void)
+{
+    for(uint i = 0; i < 2; i++) {
+        uart_inst_t *uart = &uarts[i];
+        uint irq = i == 0 ? UART0_IRQ : UART1_IRQ;
+        if(!host_irq_ready(irq)) {
+            continue;
+        }
+        // A handler that leaves its interrupt asserted would spin forever on
+        // the board; here it just gets a few more calls
+        for(uint8_t n = 0; n < 4; n++) {
+            bool rx = uart->rx_irq && uart_is_readable(uart);
+            bool tx = uart->tx_irq && tx_level(uart) <= TX_IRQ_LEVEL;
+            if(!rx && !tx) {
+                break;
+            }
+            host_irq_call(irq);
+        }
+    }
+}
+
+uint64_t host_uart_blocked_us(uart_inst_t *uart)
+{
+    return uart->blocked_ns / 1000;
+}
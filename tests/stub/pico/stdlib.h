@@ -0,0 +1,38 @@
+#ifndef HOST_PICO_STDLIB_H
+#define HOST_PICO_STDLIB_H
+
+// Host stand-in for the parts of pico/stdlib.h the tested modules use
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+// Busy-wait loops are where the board would take interrupts, so the host
+// delivers pending UART and I2C ones there
+void host_uart_service(void);
+void host_irq_service(void);
+#define tight_loop_contents() host_irq_service()
+
+// The clock follows the host's monotonic clock plus whatever the test has
+// skipped ahead with host_time_advance()
+uint64_t time_us_64(void);
+uint32_t time_us_32(void);
+absolute_time_t get_absolute_time(void);
+uint32_t to_ms_since_boot(absolute_time_t t);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+// Moves the clock on, finishing the I2C transfers that end on the way
+void host_time_advance(uint64_t us);
+
+// Stops the host clock, so time only moves with host_time_advance()
+void host_time_freeze(void);
+
+#include "hardware/gpio.h"
+
+#endif
@@ -0,0 +1,117 @@
+#include "check.h"
+#include "encoder.h"
+
+// Drives the acceleration table through encoder_decode with synthetic detent
+// timings and checks the curve lab_2 relies on.
+
+#define BUCKET_US (1u << ACCEL_BUCKET_SHIFT)
+#define SWEEP_STEPS 50 // 0..LED_FADE_LEVEL_MAX at lab_2's BRIGHTNESS_STEP of 2
+
+static const uint8_t cw_states[4] = { 0, 2, 3, 1 };
+static uint8_t phase;
+
+static int32_t detent(int8_t dir, uint32_t now_us)
+{
+    for(uint8_t q = 0; q < ENCODER_QUARTERS_PER_STEP; q++) {
+        phase = (phase + (dir > 0 ? 1 : 3)) % 4;
+        encoder_decode(cw_states[phase], now_us);
+    }
+    return encoder_take_steps();
+}
+
+static void restart(void)
+{
+    encoder_reset(cw_states[phase]);
+    encoder_take_steps();
+}
+
+// Gain of a detent `interval_us` after one in the same direction
+static int32_t gain_after(uint32_t start_us, uint32_t interval_us)
+{
+    restart();
+    detent(1, start_us);
+    return detent(1, start_us + interval_us);
+}
+
+static void test_curve(void)
+{
+    int32_t previous = ACCEL_MAX_GAIN;
+
+    printf("%10s %6s\n", "interval", "gain");
+    for(uint32_t interval = 0; interval <= (ACCEL_BUCKETS + 2) * BUCKET_US; interval += BUCKET_US / 4) {
+        int32_t gain = gain_after(1000000, interval);
+        CHECK(gain >= 1 && gain <= ACCEL_MAX_GAIN);
+        CHECK(gain <= previous);
+        previous = gain;
+        if(interval % (4 * BUCKET_US) == 0) {
+            printf("%7.1f ms %6ld\n", interval / 1000.0, (long) gain);
+        }
+    }
+    CHECK(gain_after(1000000, 0) == ACCEL_MAX_GAIN);
+    CHECK(gain_after(1000000, ACCEL_BUCKETS * BUCKET_US) == 1);
+    CHECK(gain_after(1000000, 1000000) == 1);
+}
+
+// A slow turn moves one step per detent however long it goes on
+static void test_slow(void)
+{
+    int32_t total = 0;
+    restart();
+    for(uint32_t i = 0; i < 200; i++) {
+        int32_t steps = detent(1, 1000000 + i * 80000);
+        CHECK(steps == 1);
+        total += steps;
+    }
+    CHECK(total == 200);
+}
+
+// A quick flick covers the whole brightness range in a handful of detents
+static void test_fast_sweep(void)
+{
+    const uint32_t intervals_us[] = { 1000, 3000, 5000, 10000 };
+
+    for(uint8_t i = 0; i < count_of(intervals_us); i++) {
+        int32_t total = 0;
+        uint32_t detents = 0;
+
+        restart();
+        while(total < SWEEP_STEPS && detents < 100) {
+            total += detent(1, 1000000 + detents * intervals_us[i]);
+            detents++;
+        }
+        printf("full sweep at one detent per %2lu ms: %lu detents\n",
+               (unsigned long) (intervals_us[i] / 1000), (unsigned long) detents);
+        if(intervals_us[i] <= 5000) {
+            CHECK(detents <= 8);
+        }
+    }
+}
+
+// Turning back is always a single step, however fast
+static void test_reversal(void)
+{
+    restart();
+    detent(1, 1000000);
+    detent(1, 1001000);
+    for(uint32_t i = 0; i < 20; i++) {
+        int8_t dir = i % 2 ? 1 : -1;
+        CHECK(detent(dir, 1002000 + i * 1000) == dir);
+    }
+}
+
+// The 32-bit microsecond counter wraps every 71 minutes
+static void test_wrap(void)
+{
+    CHECK(gain_after(0xFFFFFFFFu - 500, 1000) == gain_after(1000000, 1000));
+    CHECK(gain_after(0xFFFFFFFFu - 500, 1000000) == 1);
+}
+
+int main(void)
+{
+    test_curve();
+    test_slow();
+    test_fast_sweep();
+    test_reversal();
+    test_wrap();
+    return check_result();
+}
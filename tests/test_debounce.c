@@ -0,0 +1,305 @@
+#include <string.h>
+#include "check.h"
+#include "debounce.h"
+
+// Replays switch traces through debounce_update() one sample at a time, the
+// way the 1 ms repeating timer in lab_1 feeds it, and reports how long after
+// the contact first moved each press and release came out.
+
+#define PIN_TOGGLE 8
+#define PIN_INC 9
+#define EVENTS_MAX 64
+
+typedef struct Segment {
+    bool down;
+    uint16_t ms;
+} Segment;
+
+typedef struct Trace {
+    const char *name;
+    const Segment *segments;
+    uint8_t count;
+} Trace;
+
+typedef struct Recorded {
+    ButtonEvent event;
+    uint32_t ms;
+} Recorded;
+
+static Recorded events[EVENTS_MAX];
+static uint16_t event_count;
+static uint32_t now_ms;
+
+static void record(const ButtonEvent *event)
+{
+    if(event_count < EVENTS_MAX) {
+        events[event_count].event = *event;
+        events[event_count].ms = now_ms;
+        event_count++;
+    }
+}
+
+static uint32_t levels_for(uint8_t pin, bool down)
+{
+    return down ? ~(1u << pin) : ~0u;
+}
+
+static void replay(Button *button, const Segment *segments, uint8_t count)
+{
+    for(uint8_t s = 0; s < count; s++) {
+        for(uint16_t i = 0; i < segments[s].ms; i++) {
+            now_ms++;
+            debounce_update(button, 1, levels_for(button->pin, segments[s].down), record);
+        }
+    }
+}
+
+static void reset(void)
+{
+    memset(events, 0, sizeof(events));
+    event_count = 0;
+    now_ms = 0;
+}
+
+static uint16_t count_type(ButtonEventType type)
+{
+    uint16_t n = 0;
+    for(uint16_t i = 0; i < event_count; i++) {
+        if(events[i].event.type == type) {
+            n++;
+        }
+    }
+    return n;
+}
+
+static const Recorded *find_type(ButtonEventType type)
+{
+    for(uint16_t i = 0; i < event_count; i++) {
+        if(events[i].event.type == type) {
+            return &events[i];
+        }
+    }
+    return NULL;
+}
+
+// Press and release of a tactile switch: chatter on both edges, held in
+// between. Times are in samples, i.e. ms.
+static const Segment clean[] = {
+        { false, 10 }, { true, 200 }, { false, 100 }
+};
+static const Segment chatter[] = {
+        { false, 10 },
+        { true, 1 }, { false, 1 }, { true, 2 }, { false, 1 }, { true, 1 }, { false, 2 }, { true, 150 },
+        { false, 1 }, { true, 1 }, { false, 1 }, { true, 3 }, { false, 100 }
+};
+static const Segment long_chatter[] = {
+        { false, 10 },
+        { true, 3 }, { false, 2 }, { true, 4 }, { false, 3 }, { true, 2 }, { false, 1 }, { true, 5 }, { false, 2 },
+        { true, 150 },
+        { false, 2 }, { true, 2 }, { false, 3 }, { true, 4 }, { false, 1 }, { true, 1 }, { false, 100 }
+};
+static const Segment glitches[] = {
+        { false, 10 }, { true, 5 }, { false, 50 }, { true, DEBOUNCE_SAMPLES - 1 }, { false, 100 }
+};
+
+static const Trace traces[] = {
+        { "clean", clean, count_of(clean) },
+        { "chatter", chatter, count_of(chatter) },
+        { "long chatter", long_chatter, count_of(long_chatter) },
+};
+
+// Traces start released, chatter into the hold and chatter out into a final
+// released stretch. Gives when each edge started and when the contact settled.
+static void edge_times(const Trace *trace, uint32_t *press_first, uint32_t *press_settled,
+                       uint32_t *release_first, uint32_t *release_settled)
+{
+    uint32_t t = 0;
+    uint8_t hold = 0;
+
+    for(uint8_t s = 0; s < trace->count; s++) {
+        if(trace->segments[s].down && trace->segments[hold].ms < DEBOUNCE_SAMPLES) {
+            hold = s;
+        }
+        if(s == 1) {
+            *press_first = t;
+        }
+        if(s == hold) {
+            *press_settled = t;
+        }
+        if(s == hold + 1) {
+            *release_first = t;
+        }
+        *release_settled = t;
+        t += trace->segments[s].ms;
+    }
+}
+
+static void test_traces(void)
+{
+    printf("%-14s %16s %16s\n", "trace", "press (ms)", "release (ms)");
+    for(uint8_t t = 0; t < count_of(traces); t++) {
+        const Trace *trace = &traces[t];
+        Button button = { PIN_TOGGLE, false };
+        uint32_t press_first = 0, press_settled = 0, release_first = 0, release_settled = 0;
+
+        reset();
+        replay(&button, trace->segments, trace->count);
+        edge_times(trace, &press_first, &press_settled, &release_first, &release_settled);
+
+        CHECK(event_count == 2);
+        CHECK(count_type(BUTTON_PRESSED) == 1);
+        CHECK(count_type(BUTTON_RELEASED) == 1);
+
+        const Recorded *press = find_type(BUTTON_PRESSED);
+        const Recorded *release = find_type(BUTTON_RELEASED);
+        if(press == NULL || release == NULL) {
+            continue;
+        }
+        CHECK(press->ms < release->ms);
+        // Once the contact stops moving the integrator only counts one way
+        CHECK(press->ms - press_settled <= DEBOUNCE_SAMPLES);
+        CHECK(release->ms - release_settled <= DEBOUNCE_SAMPLES);
+
+        printf("%-14s %7lu (+%2lu) %10lu (+%2lu)   from first edge (after settling)\n", trace->name,
+               (unsigned long) (press->ms - press_first), (unsigned long) (press->ms - press_settled),
+               (unsigned long) (release->ms - release_first), (unsigned long) (release->ms - release_settled));
+    }
+}
+
+static void test_glitches(void)
+{
+    Button button = { PIN_TOGGLE, false };
+
+    reset();
+    replay(&button, glitches, count_of(glitches));
+    CHECK(event_count == 0);
+}
+
+static void test_repeat(void)
+{
+    const Segment hold[] = { { false, 10 }, { true, 550 }, { false, 100 } };
+    Button inc = { PIN_INC, true };
+    Button toggle = { PIN_TOGGLE, false };
+
+    reset();
+    replay(&inc, hold, count_of(hold));
+
+    const Recorded *press = find_type(BUTTON_PRESSED);
+    const Recorded *release = find_type(BUTTON_RELEASED);
+    CHECK(press != NULL && release != NULL);
+    CHECK(count_type(BUTTON_REPEAT) >= 4);
+
+    uint32_t last = press != NULL ? press->ms : 0;
+    for(uint16_t i = 0; i < event_count; i++) {
+        if(events[i].event.type != BUTTON_REPEAT) {
+            continue;
+        }
+        CHECK(events[i].event.pin == PIN_INC);
+        CHECK(events[i].ms - last == (last == press->ms ? REPEAT_DELAY_MS : REPEAT_INTERVAL_MS));
+        CHECK(release != NULL && events[i].ms < release->ms);
+        last = events[i].ms;
+    }
+
+    reset();
+    replay(&toggle, hold, count_of(hold));
+    CHECK(count_type(BUTTON_REPEAT) == 0);
+}
+
+// Both buttons share one gpio_get_all() word; chatter on one must not leak
+// into the other
+static void test_two_buttons(void)
+{
+    Button buttons[2] = { { PIN_TOGGLE, false }, { PIN_INC, false } };
+
+    reset();
+    for(uint32_t t = 0; t < 400; t++) {
+        bool toggle_down = t >= 10 && t < 200 && !(t < 16 && t % 2);
+        bool inc_down = t >= 100 && t < 300 && !(t > 290 && t % 3 == 0);
+        uint32_t levels = levels_for(PIN_TOGGLE, toggle_down) & levels_for(PIN_INC, inc_down);
+        now_ms++;
+        debounce_update(buttons, 2, levels, record);
+    }
+
+    CHECK(event_count == 4);
+    uint8_t seen[2][2] = { { 0 } };
+    for(uint16_t i = 0; i < event_count; i++) {
+        uint8_t which = events[i].event.pin == PIN_INC;
+        seen[which][events[i].event.type == BUTTON_RELEASED]++;
+    }
+    CHECK(seen[0][0] == 1 && seen[0][1] == 1);
+    CHECK(seen[1][0] == 1 && seen[1][1] == 1);
+}
+
+static uint32_t lcg(uint32_t *state)
+{
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// Random chatter of up to 10 ms on both edges; every cycle has to give
+// exactly one press and one release
+static void test_random_bounce(void)
+{
+    const uint16_t cycles = 10000;
+    uint32_t seed = 12345;
+    uint32_t worst_press = 0, worst_release = 0;
+    uint64_t total_press = 0, total_release = 0;
+    uint16_t bad = 0;
+    Button button = { PIN_TOGGLE, false };
+
+    for(uint16_t c = 0; c < cycles; c++) {
+        Segment segments[32];
+        uint8_t count = 0;
+        uint32_t press_start, release_start;
+
+        segments[count++] = (Segment) { false, 30 };
+        press_start = 30;
+        for(uint8_t ms = 0, level = 1; ms < lcg(&seed) % 10; level ^= 1) {
+            uint8_t len = 1 + lcg(&seed) % 3;
+            segments[count++] = (Segment) { level, len };
+            ms += len;
+        }
+        segments[count++] = (Segment) { true, 30 + lcg(&seed) % 300 };
+        release_start = 0;
+        for(uint8_t s = 0; s < count; s++) {
+            release_start += segments[s].ms;
+        }
+        for(uint8_t ms = 0, level = 0; ms < lcg(&seed) % 10; level ^= 1) {
+            uint8_t len = 1 + lcg(&seed) % 3;
+            segments[count++] = (Segment) { level, len };
+            ms += len;
+        }
+        segments[count++] = (Segment) { false, 50 };
+
+        reset();
+        replay(&button, segments, count);
+
+        const Recorded *press = find_type(BUTTON_PRESSED);
+        const Recorded *release = find_type(BUTTON_RELEASED);
+        if(event_count != 2 || press == NULL || release == NULL) {
+            bad++;
+            continue;
+        }
+        uint32_t press_latency = press->ms - press_start;
+        uint32_t release_latency = release->ms - release_start;
+        total_press += press_latency;
+        total_release += release_latency;
+        worst_press = press_latency > worst_press ? press_latency : worst_press;
+        worst_release = release_latency > worst_release ? release_latency : worst_release;
+    }
+
+    CHECK(bad == 0);
+    printf("random chatter, %u cycles: press %.1f ms avg %lu ms worst, release %.1f ms avg %lu ms worst\n",
+           cycles, (double) total_press / cycles, (unsigned long) worst_press,
+           (double) total_release / cycles, (unsigned long) worst_release);
+}
+
+int main(void)
+{
+    test_traces();
+    test_glitches();
+    test_repeat();
+    test_two_buttons();
+    test_random_bounce();
+    return check_result();
+}
@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <string.h>
+#include "check.h"
+#include "eeprom.h"
+#include "eeprom_sim.h"
+
+// Runs lab_4's driver itself, request queue, DMA transfers, I2C interrupt and
+// write-back cache, against the simulated 24LC256 on the host I2C bus. Random
+// reads, writes and scans of any length and alignment go through the cache
+// in both write modes with the main loop's eeprom_poll() in between, and have
+// to agree with a plain copy of what was written. Once flushed, the part has
+// to hold that copy too. Then the async requests are run up to a full queue,
+// and the part is switched off in the middle of an ACK poll.
+
+#define RANDOM_OPS 20000
+#define OP_LEN_MAX 300
+#define WRITE_AREA 0x2000 // small enough for lines to be hit and evicted often
+
+static uint8_t shadow[EEPROM_SIM_SIZE];
+
+typedef struct Done {
+    uint32_t ok;
+    uint32_t failed;
+} Done;
+
+static void request_done(bool ok, void *ctx)
+{
+    Done *done = ctx;
+
+    if(ok) {
+        done->ok++;
+    } else {
+        done->failed++;
+    }
+}
+
+typedef struct ScanCheck {
+    uint16_t next;
+    uint32_t wrong;
+} ScanCheck;
+
+static bool scan_check(uint16_t address, const uint8_t *data, size_t len, void *ctx)
+{
+    ScanCheck *check = ctx;
+
+    check->wrong += address != check->next || memcmp(data, &shadow[address], len) != 0;
+    check->next = address + len;
+    return true;
+}
+
+// What the main loop does between button presses
+static void idle(uint32_t us)
+{
+    for(uint32_t t = 0; t < us; t += 1000) {
+        host_time_advance(1000);
+        eeprom_poll();
+    }
+}
+
+static void random_ops(bool async)
+{
+    static uint8_t data[OP_LEN_MAX];
+    uint32_t wrong_reads = 0;
+    uint32_t wrong_scans = 0;
+
+    eeprom_set_async(async);
+    for(uint32_t n = 0; n < RANDOM_OPS; n++) {
+        uint16_t len = 1 + rand() % (rand() % 4 == 0 ? OP_LEN_MAX : 8);
+        uint16_t address = rand() % (WRITE_AREA - len);
+
+        switch(rand() % 8) {
+        case 0:
+        case 1:
+        case 2:
+            for(uint16_t i = 0; i < len; i++) {
+                data[i] = rand();
+            }
+            eeprom_write_multi_byte(address, data, len);
+            memcpy(&shadow[address], data, len);
+            break;
+        case 3:
+        case 4:
+            eeprom_read_multi_byte(address, data, len);
+            wrong_reads += memcmp(data, &shadow[address], len) != 0;
+            break;
+        case 5: {
+            ScanCheck check = { .next = address };
+            eeprom_scan(address, len, scan_check, &check);
+            wrong_scans += check.wrong + (check.next != address + len);
+            break;
+        }
+        case 6:
+            idle(rand() % 3 == 0 ? 300000 : 2000);
+            break;
+        default:
+            eeprom_poll();
+            break;
+        }
+    }
+    eeprom_flush();
+    CHECK(eeprom_wait_ready());
+    eeprom_poll();
+
+    EepromStats stats;
+    eeprom_get_stats(&stats);
+    printf("%s: %lu reads hit, %lu missed, %lu page writes in, %lu out, %lu ACK poll waits\n",
+           async ? "async" : "sync", (unsigned long) stats.cache_hits, (unsigned long) stats.cache_misses,
+           (unsigned long) stats.cache_writes, (unsigned long) stats.cache_flushes, (unsigned long) stats.stalls);
+    CHECK(wrong_reads == 0);
+    CHECK(wrong_scans == 0);
+    CHECK(stats.cache_dirty == 0);
+    CHECK(stats.queue_depth == 0);
+    CHECK(memcmp(host_eeprom.mem, shadow, EEPROM_SIM_SIZE) == 0);
+}
+
+// Every write goes through as a write cycle on the part, and the driver's
+// view of each cycle is the part's to within one ACK poll: START, address
+// byte and STOP
+static void check_write_cycles(void)
+{
+    EepromStats stats;
+    uint32_t poll_us = 11 * 1000000 / 400000 + 1;
+
+    eeprom_get_stats(&stats);
+    printf("%lu writes, %lu cycles measured: %lu..%lu us\n", (unsigned long) stats.writes,
+           (unsigned long) stats.measured, (unsigned long) stats.busy_min_us, (unsigned long) stats.busy_max_us);
+    CHECK(stats.writes == host_eeprom.writes);
+    CHECK(stats.timeouts == 0);
+    CHECK(stats.measured > 0);
+    CHECK(stats.busy_min_us >= EEPROM_SIM_WRITE_US && stats.busy_max_us <= EEPROM_SIM_WRITE_US + poll_us);
+}
+
+static void check_queue(void)
+{
+    static uint8_t pages[EEPROM_QUEUE_LEN + 1][PAGE_SIZE];
+    static uint8_t back[EEPROM_QUEUE_LEN][PAGE_SIZE];
+    Done writes = { 0 };
+    Done reads = { 0 };
+    uint32_t queued = 0;
+
+    // Nothing completes until the clock moves, so the queue fills up
+    eeprom_set_async(true);
+    for(uint32_t i = 0; i <= EEPROM_QUEUE_LEN; i++) {
+        uint16_t address = 0x4000 + i * PAGE_SIZE;
+        for(uint32_t j = 0; j < PAGE_SIZE; j++) {
+            pages[i][j] = rand();
+        }
+        if(eeprom_write_async(address, pages[i], PAGE_SIZE, request_done, &writes)) {
+            memcpy(&shadow[address], pages[i], PAGE_SIZE);
+            queued++;
+        }
+    }
+    CHECK(queued == EEPROM_QUEUE_LEN);
+    CHECK(!eeprom_write_async(0x4000 + 10, pages[0], PAGE_SIZE, request_done, &writes));
+
+    idle(EEPROM_QUEUE_LEN * 2 * EEPROM_SIM_WRITE_US);
+    CHECK(writes.ok == EEPROM_QUEUE_LEN && writes.failed == 0);
+
+    for(uint32_t i = 0; i < EEPROM_QUEUE_LEN; i++) {
+        CHECK(eeprom_read_async(0x4000 + i * PAGE_SIZE, back[i], PAGE_SIZE, request_done, &reads));
+    }
+    idle(4 * EEPROM_SIM_WRITE_US);
+    CHECK(reads.ok == EEPROM_QUEUE_LEN && reads.failed == 0);
+    CHECK(memcmp(back, pages, sizeof(back)) == 0);
+    CHECK(memcmp(host_eeprom.mem, shadow, EEPROM_SIM_SIZE) == 0);
+}
+
+// The part stops answering during the write cycle of the first write, so the
+// second is ACK polled until it times out and then fails
+static void check_power_loss(void)
+{
+    static const uint8_t data[4] = { 1, 2, 3, 4 };
+    Done done = { 0 };
+    EepromStats stats;
+
+    eeprom_reset_stats();
+    CHECK(eeprom_write_async(0x6000, data, sizeof(data), request_done, &done));
+    idle(1000);
+    host_eeprom.powered = false;
+    CHECK(eeprom_write_async(0x6040, data, sizeof(data), request_done, &done));
+    idle(2 * EEPROM_WRITE_TIMEOUT_US);
+    eeprom_get_stats(&stats);
+    CHECK(done.ok == 1 && done.failed == 1);
+    CHECK(stats.timeouts == 1);
+
+    eeprom_sim_power_on(&host_eeprom);
+    memcpy(&shadow[0x6000], data, sizeof(data));
+    CHECK(eeprom_wait_ready());
+    CHECK(memcmp(host_eeprom.mem, shadow, EEPROM_SIM_SIZE) == 0);
+}
+
+int main(void)
+{
+    EepromStats stats;
+
+    srand(1);
+    host_time_freeze();
+    eeprom_sim_init(&host_eeprom, MAGIC_BYTE);
+    memset(shadow, MAGIC_BYTE, sizeof(shadow));
+    host_i2c_attach(i2c1, DEV_ADDR, &eeprom_sim_target, &host_eeprom);
+
+    eeprom_init(i2c1, 400000, 2, 3);
+    eeprom_sim_reset_counts(&host_eeprom);
+    eeprom_get_stats(&stats);
+    CHECK(stats.baud_rate == 400000);
+
+    random_ops(false);
+    random_ops(true);
+    check_write_cycles();
+    check_queue();
+    check_power_loss();
+    return check_result();
+}
@@ -0,0 +1,94 @@
+#include <string.h>
+#include "check.h"
+#include "led_group.h"
+
+#define PWM_TOP 1000
+
+static uint32_t total_writes(void)
+{
+    uint32_t total = 0;
+    for(uint s = 0; s < NUM_PWM_SLICES; s++) {
+        total += host_pwm_cc_writes[s];
+    }
+    return total;
+}
+
+static bool init_group(LedGroup *group, const uint *pins, uint count)
+{
+    pwm_config config = pwm_get_default_config();
+    pwm_config_set_clkdiv_int(&config, 125);
+    pwm_config_set_wrap(&config, PWM_TOP - 1);
+
+    host_pwm_reset();
+    return led_group_init(group, pins, count, &config);
+}
+
+// The lab_1/lab_2 pins: 20 and 21 share slice 2, 22 is channel A of slice 3
+static void test_lab_pins(void)
+{
+    const uint pins[] = { 20, 21, 22 };
+    LedGroup group;
+
+    CHECK(init_group(&group, pins, count_of(pins)));
+    CHECK(group.slice_count == 2);
+    CHECK(pwm_hw->en == ((1u << 2) | (1u << 3)));
+    CHECK(pwm_hw->slice[2].top == PWM_TOP - 1 && pwm_hw->slice[3].top == PWM_TOP - 1);
+    CHECK(total_writes() == 0);
+
+    led_group_set_all(&group, 500);
+    CHECK(host_pwm_cc_writes[2] == 1);
+    CHECK(host_pwm_cc_writes[3] == 1);
+    CHECK(total_writes() == 2);
+    CHECK(pwm_hw->slice[2].cc == ((500u << 16) | 500));
+    CHECK(pwm_hw->slice[3].cc == 500);
+
+    led_group_set_all(&group, 0);
+    CHECK(total_writes() == 4);
+    CHECK(pwm_hw->slice[2].cc == 0 && pwm_hw->slice[3].cc == 0);
+
+    // A level change costs one write per slice, never one per pin
+    const uint32_t changes = 1000;
+    for(uint32_t i = 0; i < changes; i++) {
+        led_group_set_all(&group, i % PWM_TOP);
+    }
+    CHECK(total_writes() == 4 + changes * group.slice_count);
+    printf("%lu level changes on %u pins: %lu CC writes (%lu with a write per pin)\n", (unsigned long) changes,
+           group.count, (unsigned long) (changes * group.slice_count), (unsigned long) (changes * group.count));
+}
+
+// Channels the group does not own keep what was last written to them
+static void test_foreign_channel(void)
+{
+    const uint pins[] = { 21 };
+    LedGroup group;
+
+    CHECK(init_group(&group, pins, count_of(pins)));
+    group.slices[0].cc = 123; // channel A, not ours
+    led_group_set_all(&group, 700);
+    CHECK(pwm_hw->slice[2].cc == ((700u << 16) | 123));
+    CHECK(host_pwm_cc_writes[2] == 1);
+}
+
+static void test_limits(void)
+{
+    const uint eight[] = { 0, 1, 2, 3, 4, 5, 6, 7 };
+    const uint nine[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8 };
+    const uint five_slices[] = { 0, 2, 4, 6, 8 };
+    LedGroup group;
+
+    CHECK(init_group(&group, eight, count_of(eight)));
+    CHECK(group.slice_count == 4);
+    led_group_set_all(&group, 1);
+    CHECK(total_writes() == 4);
+
+    CHECK(!init_group(&group, nine, count_of(nine)));
+    CHECK(!init_group(&group, five_slices, count_of(five_slices)));
+}
+
+int main(void)
+{
+    test_lab_pins();
+    test_foreign_channel();
+    test_limits();
+    return check_result();
+}
@@ -0,0 +1,291 @@
+#include <math.h>
+#include <string.h>
+#include <sys/socket.h>
+#include "check.h"
+#include "lora_at.h"
+#include "lora_uplink.h"
+#include "lora_e5_sim.h"
+
+// Runs the lab_3 uplink path against the simulated module at 9600 baud: the
+// join, the record queue, the frame packer, the airtime estimate and the
+// duty-cycle wait. Waits run on the virtual clock; only the UART itself
+// moves at its real rate.
+
+#define RECORD_LEN 6
+#define RECORDS_PER_FRAME (UPLINK_MAX_PAYLOAD / (1 + RECORD_LEN))
+#define IDLE_STEP_US 100000
+
+static LoraSim sim;
+static uint32_t next_record;
+static uint64_t frame_at_us;
+static uint64_t longest_poll_us;
+
+static void make_record(uint8_t *record, uint32_t n)
+{
+    for(uint8_t i = 0; i < RECORD_LEN; i++) {
+        record[i] = (uint8_t) (n * 7 + i);
+    }
+}
+
+static bool queue_next(void)
+{
+    uint8_t record[RECORD_LEN];
+    make_record(record, next_record);
+    if(!uplink_queue(record, sizeof(record))) {
+        return false;
+    }
+    next_record++;
+    return true;
+}
+
+static void pump(void)
+{
+    uint64_t start = time_us_64();
+    uplink_poll();
+    uint64_t took = time_us_64() - start;
+    if(took > longest_poll_us) {
+        longest_poll_us = took;
+    }
+
+    host_uart_service();
+    at_poll();
+    lora_sim_poll(&sim);
+}
+
+static bool link_idle(void)
+{
+    AtStats stats;
+    at_get_stats(&stats);
+    return stats.tx_queued == 0 && sim.line_pos == 0;
+}
+
+// Lets the engine and the uplink state machine catch up with what the
+// module last answered
+static void settle(void)
+{
+    for(uint32_t n = 0; n < 1000; n++) {
+        pump();
+    }
+}
+
+// Pumps until the module has taken `frames` uplinks or `limit_us` of virtual
+// time has gone by. Time is skipped ahead only while no command is on the
+// wire, so the UART keeps its real pace.
+static bool wait_frames(uint32_t frames, uint64_t limit_us)
+{
+    uint64_t end = time_us_64() + limit_us;
+    uint32_t seen = sim.frames;
+
+    while(sim.frames < frames && time_us_64() < end) {
+        pump();
+        if(sim.frames != seen) {
+            seen = sim.frames;
+            frame_at_us = time_us_64();
+        } else if(link_idle()) {
+            host_time_advance(IDLE_STEP_US);
+        }
+    }
+    return sim.frames >= frames;
+}
+
+// The frame the module last took holds records first..first+count-1, each
+// behind its length byte
+static bool frame_holds(uint32_t first, uint32_t count)
+{
+    uint8_t record[RECORD_LEN];
+    uint8_t pos = 0;
+
+    if(sim.payload_len != count * (1 + RECORD_LEN)) {
+        return false;
+    }
+    for(uint32_t n = first; n < first + count; n++) {
+        make_record(record, n);
+        if(sim.payload[pos] != RECORD_LEN || memcmp(&sim.payload[pos + 1], record, RECORD_LEN) != 0) {
+            return false;
+        }
+        pos += 1 + RECORD_LEN;
+    }
+    return true;
+}
+
+static void test_join(void)
+{
+    UplinkStats stats;
+
+    for(uint32_t n = 0; n < 100000 && !sim.joined; n++) {
+        pump();
+    }
+    settle();
+    uplink_get_stats(&stats);
+    CHECK(sim.joined);
+    CHECK(stats.joined);
+}
+
+// Enough records for a full frame go out at once, packed in order, and the
+// main loop does not wait for the UART while the ~120 ms command goes out
+static void test_pack(void)
+{
+    UplinkStats stats;
+    uint64_t blocked = host_uart_blocked_us(uart1);
+
+    longest_poll_us = 0;
+    for(uint32_t i = 0; i <= RECORDS_PER_FRAME; i++) {
+        CHECK(queue_next());
+    }
+    CHECK(wait_frames(1, 1000000));
+    CHECK(frame_holds(0, RECORDS_PER_FRAME));
+
+    settle();
+    uplink_get_stats(&stats);
+    CHECK(stats.frames_sent == 1);
+    CHECK(stats.records_sent == RECORDS_PER_FRAME);
+    CHECK(stats.payload_bytes == RECORDS_PER_FRAME * (1 + RECORD_LEN));
+    CHECK(stats.queue_depth == 1);
+    CHECK(host_uart_blocked_us(uart1) - blocked < 1000);
+    CHECK(longest_poll_us < 5000);
+    printf("full frame: %u bytes, longest uplink_poll %lu us, %lu us blocked on the UART\n",
+           sim.payload_len, (unsigned long) longest_poll_us,
+           (unsigned long) (host_uart_blocked_us(uart1) - blocked));
+}
+
+// The next frame waits out the 1% band the last one closed
+static void test_duty_cycle(void)
+{
+    uint64_t last_at = frame_at_us;
+    uint64_t off_us = 99ull * uplink_airtime_us(RECORDS_PER_FRAME * (1 + RECORD_LEN));
+    UplinkStats stats;
+
+    uplink_get_stats(&stats);
+    CHECK(stats.bands[0].wait_us > 0);
+    CHECK(stats.bands[0].frames == 1);
+
+    for(uint32_t i = 0; i < RECORDS_PER_FRAME; i++) {
+        CHECK(queue_next());
+    }
+    CHECK(wait_frames(2, 2 * off_us));
+    CHECK(frame_at_us - last_at >= off_us);
+    CHECK(frame_holds(RECORDS_PER_FRAME, RECORDS_PER_FRAME));
+    printf("second frame %.1f s after the first, band off period %.1f s\n",
+           (frame_at_us - last_at) / 1e6, off_us / 1e6);
+}
+
+// A lone record is held back until it has waited UPLINK_MAX_HOLD_US
+static void test_hold(void)
+{
+    uint32_t first;
+
+    // Send the leftover record and let the band reopen
+    CHECK(wait_frames(3, 1000000000));
+    CHECK(frame_holds(2 * RECORDS_PER_FRAME, 1));
+    host_time_advance(100ull * uplink_airtime_us(UPLINK_MAX_PAYLOAD));
+
+    first = next_record;
+    CHECK(queue_next());
+    CHECK(!wait_frames(4, UPLINK_MAX_HOLD_US - 2 * IDLE_STEP_US));
+    CHECK(wait_frames(4, 4 * IDLE_STEP_US));
+    CHECK(frame_holds(first, 1));
+}
+
+// The queue takes UPLINK_QUEUE_LEN records while the band is closed, drops the
+// rest, and then drains in order
+static void test_queue_bounds(void)
+{
+    UplinkStats before;
+    UplinkStats after;
+    uint8_t record[UPLINK_RECORD_MAX + 1] = { 0 };
+    uint32_t first = next_record;
+
+    uplink_get_stats(&before);
+    CHECK(before.bands[0].wait_us > 0);
+    for(uint32_t i = 0; i < UPLINK_QUEUE_LEN; i++) {
+        CHECK(queue_next());
+    }
+    CHECK(!queue_next());
+    CHECK(!uplink_queue(record, 0));
+    CHECK(!uplink_queue(record, UPLINK_RECORD_MAX + 1));
+
+    uint32_t frames = sim.frames;
+    for(uint32_t sent = 0; sent < UPLINK_QUEUE_LEN; ) {
+        uint32_t count = UPLINK_QUEUE_LEN - sent < RECORDS_PER_FRAME ? UPLINK_QUEUE_LEN - sent : RECORDS_PER_FRAME;
+        CHECK(wait_frames(++frames, 1000000000));
+        CHECK(frame_holds(first + sent, count));
+        sent += count;
+    }
+
+    uplink_get_stats(&after);
+    CHECK(after.queue_peak == UPLINK_QUEUE_LEN);
+    CHECK(after.dropped == before.dropped + 3);
+    CHECK(after.queue_depth == 0);
+}
+
+// An uplink the module rejects is sent again, unchanged, in the next window
+static void test_retry(void)
+{
+    UplinkStats before;
+    UplinkStats after;
+    uint32_t first = next_record;
+
+    settle();
+    host_time_advance(100ull * uplink_airtime_us(UPLINK_MAX_PAYLOAD));
+    uplink_get_stats(&before);
+    sim.faults.error_permille = 1000;
+    for(uint32_t i = 0; i <= RECORDS_PER_FRAME; i++) {
+        CHECK(queue_next());
+    }
+    CHECK(!wait_frames(sim.frames + 1, UPLINK_SEND_TIMEOUT_US + 10 * IDLE_STEP_US));
+    settle();
+    uplink_get_stats(&after);
+    CHECK(after.frames_failed == before.frames_failed + 1);
+
+    sim.faults.error_permille = 0;
+    CHECK(wait_frames(sim.frames + 1, 1000000000));
+    CHECK(frame_holds(first, RECORDS_PER_FRAME));
+    settle();
+    uplink_get_stats(&after);
+    CHECK(after.frames_sent == before.frames_sent + 1);
+    CHECK(after.records_sent == before.records_sent + RECORDS_PER_FRAME);
+}
+
+// Semtech AN1200.13 in floating point, for SF12, BW 125 kHz, CR 4/5, explicit
+// header, CRC on, low data rate optimisation on and 13 bytes of LoRaWAN framing
+static double airtime_reference_us(uint8_t payload_len)
+{
+    const double t_sym = 4096.0 / 125000.0;
+    double pl = payload_len + 13;
+    double symbols = 8 + fmax(ceil((8 * pl - 4 * 12 + 28 + 16) / (4 * (12 - 2))) * 5, 0);
+    return ((8 + 4.25) * t_sym + symbols * t_sym) * 1e6;
+}
+
+static void test_airtime(void)
+{
+    printf("%8s %12s\n", "payload", "airtime");
+    for(uint8_t len = 0; len <= UPLINK_MAX_PAYLOAD; len++) {
+        double reference = airtime_reference_us(len);
+        CHECK(fabs(uplink_airtime_us(len) - reference) <= 1.0);
+        if(len % 10 == 0 || len == UPLINK_MAX_PAYLOAD) {
+            printf("%8u %9.1f ms\n", len, uplink_airtime_us(len) / 1000.0);
+        }
+    }
+}
+
+int main(void)
+{
+    int fds[2];
+
+    if(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        printf("socketpair failed\n");
+        return 1;
+    }
+    lora_sim_init(&sim, fds[1], 9600);
+    at_init(uart1, 9600, 4, 5);
+    host_uart_attach(uart1, fds[0]);
+
+    test_airtime();
+    test_join();
+    test_pack();
+    test_duty_cycle();
+    test_hold();
+    test_queue_bounds();
+    test_retry();
+    return check_result();
+}
@@ -0,0 +1,108 @@
+#include "check.h"
+#include "stepper.h"
+#include "hardware/timer.h"
+
+// Plans lab_5's run profiles and plays moves of every length through the
+// stepper's alarm handler on a stopped clock, so each step lands exactly on
+// its scheduled time. The motor must never step faster than the ramp has
+// got it to, speed up only on the way in and slow down only on the way out,
+// and take as long as motion_move_time_us() says.
+
+#define RUN_MAX_RATE 2000
+#define RUN_ACCEL 5000
+#define RUN_JERK 50000
+#define MOVES_MAX 2048
+#define RECORD_MAX 2048
+
+typedef struct Move {
+    uint32_t steps;
+    uint32_t intervals[RECORD_MAX];
+    uint32_t count;
+    uint64_t time_us;
+} Move;
+
+static void run_move(const MotionPlan *plan, uint32_t steps, Move *move)
+{
+    uint64_t last = time_us_64();
+    uint64_t start = last;
+
+    move->steps = steps;
+    move->count = 0;
+    CHECK(stepper_move_plan(0, steps, plan));
+    while(stepper_busy() && host_alarm_fire()) {
+        uint64_t now = time_us_64();
+        if(move->count < RECORD_MAX) {
+            move->intervals[move->count++] = now - last;
+        }
+        last = now;
+    }
+    move->time_us = last - start;
+    CHECK(!stepper_busy());
+}
+
+// True if the intervals fall to their shortest and rise again, never jumping
+// below the slowest speed the ramp reached on the way
+static bool move_is_smooth(const MotionPlan *plan, const Move *move)
+{
+    uint32_t ramp = motion_ramp_steps(plan, move->steps);
+    uint32_t floor_fp = ramp < plan->ramp_len ? plan->ramp_fp[ramp > 0 ? ramp - 1 : 0] : plan->cruise_fp;
+    uint32_t i = 1;
+
+    while(i < move->count && move->intervals[i] <= move->intervals[i - 1] + 1) {
+        i++;
+    }
+    while(i < move->count && move->intervals[i] + 1 >= move->intervals[i - 1]) {
+        i++;
+    }
+    if(i < move->count) {
+        return false;
+    }
+    for(i = 0; i < move->count; i++) {
+        if(move->intervals[i] < floor_fp >> 8) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void test_plan(const char *name, const MotionPlan *plan)
+{
+    static Move move;
+    uint32_t rough = 0;
+    uint32_t wrong_time = 0;
+
+    printf("%s: %u ramp steps, cruise %lu us\n", name, plan->ramp_len, (unsigned long) (plan->cruise_fp >> 8));
+    for(uint32_t steps = 1; steps <= MOVES_MAX; steps++) {
+        run_move(plan, steps, &move);
+        CHECK(move.count == steps - 1);
+        if(!move_is_smooth(plan, &move)) {
+            rough++;
+        }
+        if(move.time_us != motion_move_time_us(plan, steps)) {
+            wrong_time++;
+        }
+        if(steps == 4 || steps == 512 || steps == MOVES_MAX) {
+            uint32_t middle = move.intervals[(steps - 1) / 2];
+            printf("%6lu steps: %8llu us, middle interval %lu us, first %lu us\n", (unsigned long) steps,
+                   move.time_us, (unsigned long) middle, (unsigned long) move.intervals[0]);
+        }
+    }
+    CHECK(rough == 0);
+    CHECK(wrong_time == 0);
+    printf("%lu moves not smooth, %lu off their planned time\n", (unsigned long) rough,
+           (unsigned long) wrong_time);
+}
+
+int main(void)
+{
+    static MotionPlan plan;
+
+    host_time_freeze();
+    stepper_init(2, 3, 6, 13, 28);
+
+    motion_plan_trapezoid(&plan, RUN_MAX_RATE, RUN_ACCEL);
+    test_plan("trapezoid", &plan);
+    motion_plan_scurve(&plan, RUN_MAX_RATE, RUN_ACCEL, RUN_JERK);
+    test_plan("S-curve", &plan);
+    return check_result();
+}
@@ -0,0 +1,241 @@
+#include <string.h>
+#include "check.h"
+#include "eeprom_sim.h"
+#include "eeprom_log.h"
+#include "led_state.h"
+
+// Cuts the power in the middle of every byte the lab_4 storage layer writes
+// for an LED change, over enough changes to wrap both the log and the LED
+// slot ring, and boots again each time. The log has to come back as it was
+// before the change or after it, the LEDs in the state before or after it,
+// and both have to keep working from there. A torn sequence number would
+// only mislead the binary searches a pass later, so the sequence numbers in
+// both rings are checked directly once the next changes have gone in.
+
+#define EVENTS 560
+#define AFTER_EVENTS 2 // the next one rewrites whatever the cut tore
+#define RECORDS_MAX (LOG_BLOCK_COUNT * LOG_BLOCK_SIZE / 4)
+#define SEQ_ERASED ((uint32_t) MAGIC_BYTE * 0x01010101)
+
+typedef struct Trace {
+    LogRecord records[RECORDS_MAX];
+    uint32_t count;
+    uint32_t bad; // blocks ending in a record that fails its CRC
+} Trace;
+
+static uint8_t before[EEPROM_SIM_SIZE];
+static uint8_t after[EEPROM_SIM_SIZE];
+
+static void trace_record(const LogRecord *record, void *ctx)
+{
+    Trace *trace = ctx;
+
+    if(record == NULL) {
+        trace->bad++;
+    } else if(trace->count < RECORDS_MAX) {
+        trace->records[trace->count++] = *record;
+    }
+}
+
+static void trace_log(Trace *trace)
+{
+    trace->count = 0;
+    trace->bad = 0;
+    log_for_each(trace_record, trace);
+}
+
+static bool same_record(const LogRecord *a, const LogRecord *b)
+{
+    return a->type == b->type && a->led == b->led && a->state == b->state && a->time_s == b->time_s;
+}
+
+// True if `b` is the last `count` records of `a`
+static bool trace_ends(const Trace *a, const Trace *b, uint32_t count)
+{
+    if(b->count != count || count > a->count) {
+        return false;
+    }
+    for(uint32_t i = 0; i < count; i++) {
+        if(!same_record(&a->records[a->count - count + i], &b->records[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void boot(LED_State *leds)
+{
+    eeprom_sim_power_on(&host_eeprom);
+    log_init();
+    for(uint8_t i = 0; i < 3; i++) {
+        leds[i].pin = 20 + i;
+        led_set_state(&leds[i], LED_OFF);
+    }
+    if(eeprom_leds_are_initialized()) {
+        led_read_state_to_struct(leds);
+    }
+}
+
+static bool same_states(const LED_State *a, const LED_State *b)
+{
+    for(uint8_t i = 0; i < 3; i++) {
+        if(a[i].state != b[i].state) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// What main.c does for a button press: toggle, store the states, log it
+static void led_event(LED_State *leds, uint32_t n)
+{
+    uint8_t index = (n * 7 + n / 5) % 3;
+    led_set_state(&leds[index], leds[index].state == LED_ON ? LED_OFF : LED_ON);
+    eeprom_store_led_state_from_struct(leds);
+
+    // Every fourth gap is long enough to need a two byte delta
+    LogRecord record = {
+        .type = LOG_EVENT_LED,
+        .led = index,
+        .state = leds[index].state == LED_ON,
+        .time_s = n * 20 + n / 4 * 280
+    };
+    log_append(&record);
+}
+
+// Each sequence number along a ring is one more than the one before it,
+// except at the newest, after which come the oldest or unwritten entries
+static bool seqs_in_order(const uint32_t *seq, uint32_t n)
+{
+    uint32_t breaks = 0;
+
+    for(uint32_t i = 0; i + 1 < n; i++) {
+        if(seq[i] == SEQ_ERASED) {
+            if(seq[i + 1] != SEQ_ERASED) {
+                return false;
+            }
+        } else if(seq[i + 1] != seq[i] + 1) {
+            if(seq[i + 1] != SEQ_ERASED && seq[i + 1] != seq[i] + 1 - n) {
+                return false;
+            }
+            breaks++;
+        }
+    }
+    return breaks <= 1;
+}
+
+static bool slots_in_order(void)
+{
+    uint32_t seq[LED_SLOT_COUNT];
+
+    for(uint32_t i = 0; i < LED_SLOT_COUNT; i++) {
+        memcpy(&seq[i], &host_eeprom.mem[LED_RING_ADDR + i * LED_SLOT_SIZE], sizeof(seq[i]));
+    }
+    return seqs_in_order(seq, LED_SLOT_COUNT);
+}
+
+// The log is never erased here, so every block is in the first epoch
+static bool blocks_in_order(void)
+{
+    uint32_t seq[LOG_BLOCK_COUNT];
+
+    for(uint32_t i = 0; i < LOG_BLOCK_COUNT; i++) {
+        const uint8_t *header = &host_eeprom.mem[LOG_BASE_ADDR + i * LOG_BLOCK_SIZE];
+        uint32_t value = (uint32_t) header[1] << 24 | (uint32_t) header[2] << 16 | header[3] << 8 | header[4];
+        seq[i] = header[0] == 1 ? value : SEQ_ERASED;
+    }
+    return seqs_in_order(seq, LOG_BLOCK_COUNT);
+}
+
+static uint32_t bytes_written(void)
+{
+    EepromStats stats;
+    eeprom_get_stats(&stats);
+    return stats.bytes_written;
+}
+
+// Reboots into the image in `before`, cuts the power once `cut` bytes of
+// event `n` have been programmed, and checks what the next boot finds
+static bool check_cut(uint32_t n, uint32_t cut, const Trace *old_trace, const LED_State *old_leds,
+                      const Trace *new_trace, const LED_State *new_leds)
+{
+    static Trace trace;
+    LED_State leds[3];
+    bool ok = true;
+
+    memcpy(host_eeprom.mem, before, EEPROM_SIM_SIZE);
+    boot(leds);
+    eeprom_sim_cut_after(&host_eeprom, cut);
+    led_event(leds, n);
+    CHECK(!host_eeprom.powered);
+
+    boot(leds);
+    trace_log(&trace);
+
+    // Taking over a block drops the records it held before its header is
+    // rewritten, so the old log may come back short of them
+    bool log_old = trace_ends(old_trace, &trace, trace.count) && trace.count + 1 >= new_trace->count;
+    bool log_new = trace_ends(new_trace, &trace, new_trace->count);
+    ok = ok && (log_old || log_new);
+    ok = ok && (same_states(leds, old_leds) || same_states(leds, new_leds));
+
+    // Both keep going from whichever state they came back in
+    LED_State expected[3];
+    for(uint32_t i = 1; i <= AFTER_EVENTS; i++) {
+        led_event(leds, n + i);
+    }
+    memcpy(expected, leds, sizeof(expected));
+    boot(leds);
+    ok = ok && same_states(leds, expected);
+    ok = ok && slots_in_order() && blocks_in_order();
+
+    trace_log(&trace);
+    ok = ok && trace.count >= AFTER_EVENTS;
+    for(uint32_t i = 0; ok && i < AFTER_EVENTS; i++) {
+        const LogRecord *record = &trace.records[trace.count - AFTER_EVENTS + i];
+        ok = record->time_s == (n + 1 + i) * 20 + (n + 1 + i) / 4 * 280;
+    }
+    return ok;
+}
+
+int main(void)
+{
+    static Trace old_trace;
+    static Trace new_trace;
+    LED_State old_leds[3];
+    LED_State new_leds[3];
+    uint32_t cuts = 0;
+    uint32_t failed = 0;
+
+    eeprom_init(NULL, 400000, 0, 0);
+    eeprom_sim_init(&host_eeprom, MAGIC_BYTE);
+    memcpy(before, host_eeprom.mem, EEPROM_SIM_SIZE);
+
+    for(uint32_t n = 0; n < EVENTS; n++) {
+        // The change as it goes when the power stays on
+        memcpy(host_eeprom.mem, before, EEPROM_SIM_SIZE);
+        boot(old_leds);
+        trace_log(&old_trace);
+        memcpy(new_leds, old_leds, sizeof(new_leds));
+        uint32_t start = bytes_written();
+        led_event(new_leds, n);
+        uint32_t len = bytes_written() - start;
+        memcpy(after, host_eeprom.mem, EEPROM_SIM_SIZE);
+        trace_log(&new_trace);
+
+        for(uint32_t cut = 0; cut < len; cut++) {
+            if(!check_cut(n, cut, &old_trace, old_leds, &new_trace, new_leds)) {
+                printf("event %lu: cut after %lu of %lu bytes not recovered\n", (unsigned long) n,
+                       (unsigned long) cut, (unsigned long) len);
+                failed++;
+            }
+            cuts++;
+        }
+        memcpy(before, after, EEPROM_SIM_SIZE);
+    }
+
+    printf("%lu power cuts over %u LED changes, %lu not recovered\n", (unsigned long) cuts, EVENTS,
+           (unsigned long) failed);
+    CHECK(failed == 0);
+    return check_result();
+}